@@ -0,0 +1,1027 @@
+#include "stdafx.h"
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include "Camera.h"
+#include "CpuFeatures.h"
+#include "ImageWriter.h"
+#include "Profiler.h"
+#include "Quaternion.h"
+#include "ResolutionController.h"
+#include "MatrixKinds.h"
+#include "Object.h"
+#include "SceneFile.h"
+#include "SphereKernels.h"
+#include "TripleBuffer.h"
+
+// Headless benchmark for the ray tracer: renders a fixed number of frames without creating a window
+// and reports frame time statistics as JSON.
+//
+// Usage: comp270-benchmark [--frames N] [--warmup N] [--threads N] [--resolution WxH] [--spheres N] [--kernel name] [--store objects|scene] [--no-bvh] [--progressive] [--scene file] [--save-scene file] [--image file] [--trace file.json] [--output file.json] [--verify] [--matrices]
+//
+// --store scene traces the type-segregated scene store rather than the objects themselves. The default is the objects
+// for the built-in scene, and the store for a --scene file (whose objects are then never created).
+// --no-bvh tests every object against each packet of rays rather than traversing the bounding volume hierarchy.
+// --progressive renders each frame as the camera would while moving, i.e. only the first (coarsest) refinement pass.
+// --scene loads the scene from a text or binary scene file (instead of the application's scene plus --spheres random ones),
+// reporting how long it took. --save-scene writes the scene that is benchmarked to a binary scene file.
+// --image writes the last frame to a PPM or PNG file (chosen by the extension), e.g. for comparing against a reference image.
+// --trace writes the zones recorded by the profiler to a Chrome trace file (the build must define ENABLE_PROFILER).
+// --verify checks that every SIMD kernel the CPU supports gives bit-identical results to the scalar code, instead of benchmarking.
+// It also checks that the plane packet test and the scene store's plane loop match Plane::getIntersection, that the
+// scene store finds the same closest primitive as the objects for a mix of every type, and that tracing packets through
+// the BVH finds the same objects as tracing one ray at a time, and that Matrix3D::transformPoints/transformVectors give
+// bit-identical results to operator*. It then feeds the resolution controller simulated frame times, checking that it
+// lowers the scale when frames are too slow (even if the view then stops moving), holds it near the target and raises it again.
+// It checks that a TripleBuffer read on one thread while another publishes to it only ever hands over whole, newer values.
+// Finally it applies 10000 small random rotations to a Quaternion, checking that its axes stay orthonormal throughout.
+// --matrices times point, vector and matrix-matrix products with a general Matrix3D and with each kind of KindMatrix3D
+// (reporting each kind's speedup over the projective kind, whose products are the general 4x4 ones, inlined like the rest), and
+// transforming points and vectors one at a time with operator* against in batches with transformPoints/transformVectors,
+// instead of benchmarking.
+
+namespace
+{
+	// Settings read from the command line
+	struct Options
+	{
+		unsigned	frames = 200;		// Number of frames to time
+		unsigned	warmup = 10;		// Number of untimed frames to render first
+		unsigned	threads = 0;		// Number of render threads (zero for the camera's default)
+		unsigned	resolutionX = 0;	// Size of the rendered image (zero for the camera's default)
+		unsigned	resolutionY = 0;
+		unsigned	spheres = 0;		// Number of extra randomly placed spheres to add to the scene
+		std::string	kernel;				// Name of the sphere kernel to use (empty for the best one supported)
+		bool		useSceneStore = false;	// If true, trace the scene store rather than the objects
+		bool		storeChosen = false;	// Set if --store was given (otherwise a loaded scene file's store is traced)
+		bool		useBVH = true;		// If false, test every object rather than using the hierarchy
+		bool		progressive = false;	// If true, render progressively
+		std::string	scenePath;			// Scene file to load (empty for the built-in scene)
+		std::string	saveScenePath;		// File to save the scene to in the binary format (empty to not save it)
+		std::string	imagePath;			// File to write the last frame to (empty to not write it)
+		std::string	tracePath;			// File to write the profiler trace to (empty to not write it)
+		std::string	outputPath;			// File to write the results to (empty for stdout)
+		bool		verify = false;		// If true, check the kernels rather than running the benchmark
+		bool		matrices = false;	// If true, time the matrix products rather than running the benchmark
+	};
+
+	// Summary statistics for a set of timings
+	struct Stats
+	{
+		double min = 0.0, median = 0.0, p99 = 0.0, mean = 0.0;
+	};
+
+	// Returns the number of milliseconds elapsed since the given time
+	double getMsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Returns the value below which the given fraction of the (sorted) samples fall
+	double getPercentile(const std::vector<double>& sorted, double fraction)
+	{
+		size_t idx = (size_t)std::ceil(fraction * sorted.size());
+		return sorted[idx > 0 ? idx - 1 : 0];
+	}
+
+	Stats getStats(std::vector<double> samples)
+	{
+		Stats stats;
+		if (samples.empty())
+			return stats;
+
+		std::sort(samples.begin(), samples.end());
+		stats.min = samples.front();
+		stats.median = getPercentile(samples, 0.5);
+		stats.p99 = getPercentile(samples, 0.99);
+		stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+		return stats;
+	}
+
+	// Returns the string with characters that are special in JSON strings escaped
+	std::string escapeJson(const std::string& str)
+	{
+		std::string escaped;
+		for (char c : str)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	void writeStats(std::ostream& out, const char* name, const Stats& stats)
+	{
+		out << "\"" << name << "\": { \"min\": " << stats.min << ", \"median\": " << stats.median
+			<< ", \"p99\": " << stats.p99 << ", \"mean\": " << stats.mean << " }";
+	}
+
+	// Returns false if an unrecognised or incomplete argument is found
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int argIdx = 1; argIdx < argc; ++argIdx)
+		{
+			std::string arg = argv[argIdx];
+			if (arg == "--verify")
+			{
+				options.verify = true;
+				continue;
+			}
+			if (arg == "--matrices")
+			{
+				options.matrices = true;
+				continue;
+			}
+			if (arg == "--no-bvh")
+			{
+				options.useBVH = false;
+				continue;
+			}
+			if (arg == "--progressive")
+			{
+				options.progressive = true;
+				continue;
+			}
+			if (argIdx + 1 >= argc)
+				return false;
+
+			const char* value = argv[++argIdx];
+			if (arg == "--frames")
+				options.frames = (unsigned)max(1, atoi(value));
+			else if (arg == "--warmup")
+				options.warmup = (unsigned)max(0, atoi(value));
+			else if (arg == "--threads")
+				options.threads = (unsigned)max(0, atoi(value));
+			else if (arg == "--resolution" && sscanf(value, "%ux%u", &options.resolutionX, &options.resolutionY) == 2)
+				continue;
+			else if (arg == "--spheres")
+				options.spheres = (unsigned)max(0, atoi(value));
+			else if (arg == "--kernel")
+				options.kernel = value;
+			else if (arg == "--store" && (strcmp(value, "objects") == 0 || strcmp(value, "scene") == 0))
+			{
+				options.useSceneStore = strcmp(value, "scene") == 0;
+				options.storeChosen = true;
+			}
+			else if (arg == "--scene")
+				options.scenePath = value;
+			else if (arg == "--save-scene")
+				options.saveScenePath = value;
+			else if (arg == "--image")
+				options.imagePath = value;
+			else if (arg == "--trace")
+				options.tracePath = value;
+			else if (arg == "--output")
+				options.outputPath = value;
+			else
+				return false;
+		}
+
+		return true;
+	}
+
+	// Returns the sphere kernel type with the given name
+	bool findKernelType(const std::string& name, SphereKernels::Type& type)
+	{
+		const SphereKernels::Type types[] = { SphereKernels::Type::Scalar, SphereKernels::Type::SSE41, SphereKernels::Type::AVX2, SphereKernels::Type::AVX512 };
+		for (auto candidate : types)
+		{
+			if (name == SphereKernels::getName(candidate))
+			{
+				type = candidate;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Returns true if the two sets of hits are identical, down to the bits of the distances
+	bool hitsMatch(const PacketHits& a, const PacketHits& b, unsigned count)
+	{
+		return memcmp(a.distance, b.distance, count * sizeof(float)) == 0
+			&& memcmp(a.object, b.object, count * sizeof(const Object*)) == 0;
+	}
+
+	// Returns a random packet of unit-length rays starting at a random point.
+	// Params:
+	//	rng			random number generator (input/output)
+	//	target		point that half of the rays are aimed near, so that they hit whatever is there (input)
+	RayPacket makeRandomPacket(std::mt19937& rng, const Point3D& target)
+	{
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f), offset(-5.0f, 5.0f);
+		std::uniform_int_distribution<unsigned> packetSize(1, RayPacket::c_maxSize);
+
+		RayPacket packet;
+		packet.origin = Point3D(position(rng), position(rng), position(rng));
+		packet.count = packetSize(rng);
+		for (unsigned rayIdx = 0; rayIdx < packet.count; ++rayIdx)
+		{
+			Vector3D dir = rayIdx % 2 == 0 ? Vector3D(position(rng), position(rng), position(rng))
+										   : (target + Vector3D(offset(rng), offset(rng), offset(rng))) - packet.origin;
+			dir.normalise();
+			packet.dirX[rayIdx] = dir.x;
+			packet.dirY[rayIdx] = dir.y;
+			packet.dirZ[rayIdx] = dir.z;
+		}
+		packet.padDirections();
+		return packet;
+	}
+
+	// Returns a new plane with a random centre, orientation and size (a size of zero or less, which about a quarter of the
+	// planes get in each direction, leaves the plane infinite in that direction). The caller must delete it.
+	Plane* makeRandomPlane(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f), halfSize(-5.0f, 15.0f);
+		Vector3D normal(position(rng), position(rng), position(rng));
+		normal.normalise();
+		Vector3D up = normal.cross(Vector3D(position(rng), position(rng), position(rng)));
+		up.normalise();
+		return new Plane(Point3D(position(rng), position(rng), position(rng)), normal, up, halfSize(rng) * 2.0f, halfSize(rng) * 2.0f);
+	}
+
+	// Intersects random packets with pairs of random planes (some of them infinite in one or both directions) using
+	// Plane::getPacketIntersections and the scene store, and compares the results with Plane::getIntersection.
+	// Params:
+	//	numPackets			number of packets to test (input)
+	//	packetMismatches	number of packets where Plane::getPacketIntersections gave different results (output)
+	//	storeMismatches		number of packets where Scene::getClosestIntersection gave different results (output)
+	void verifyPlanes(unsigned numPackets, unsigned& packetMismatches, unsigned& storeMismatches)
+	{
+		std::mt19937 rng(270);
+		RayCounters counters;	// Not reported, so that the checks' tests stay out of the totals
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+		packetMismatches = storeMismatches = 0;
+		for (unsigned packetIdx = 0; packetIdx < numPackets; ++packetIdx)
+		{
+			Plane* planes[2] = { makeRandomPlane(rng), makeRandomPlane(rng) };
+			const RayPacket packet = makeRandomPacket(rng, Point3D(position(rng), position(rng), position(rng)));
+
+			PacketHits expected;
+			planes[0]->Object::getPacketIntersections(packet, expected, counters);
+			planes[1]->Object::getPacketIntersections(packet, expected, counters);
+
+			PacketHits hits;
+			planes[0]->getPacketIntersections(packet, hits, counters);
+			planes[1]->getPacketIntersections(packet, hits, counters);
+			if (!hitsMatch(hits, expected, packet.count))
+				++packetMismatches;
+
+			// The store holds the planes in the same order, so each hit's index identifies the plane
+			Scene scene;
+			scene.addObjects(std::vector<Object*>(planes, planes + 2));
+			for (unsigned rayIdx = 0; rayIdx < packet.count; ++rayIdx)
+			{
+				Scene::Hit hit;
+				scene.getClosestIntersection(packet.origin, Vector3D(packet.dirX[rayIdx], packet.dirY[rayIdx], packet.dirZ[rayIdx]), hit, counters);
+				const Object* object = hit.type == Scene::PrimitiveType::Plane ? planes[hit.index] : nullptr;
+				if (object != expected.object[rayIdx] || memcmp(&hit.distance, &expected.distance[rayIdx], sizeof(float)) != 0)
+				{
+					++storeMismatches;
+					break;
+				}
+			}
+
+			delete planes[0];
+			delete planes[1];
+		}
+	}
+
+	// Traces random rays through a scene store holding a mix of random spheres and planes, and compares the closest
+	// primitive with the one found by testing every object with Object::getIntersection, so that a primitive type the
+	// store doesn't trace (or traces differently) shows up as a mismatch. Returns the number of mismatching packets.
+	unsigned verifyStore(unsigned numPackets)
+	{
+		std::mt19937 rng(270);
+		RayCounters counters;	// Not reported, so that the checks' tests stay out of the totals
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f), radius(0.1f, 3.0f);
+		std::vector<Object*> spheres, planes, objects;
+		for (unsigned objIdx = 0; objIdx < 20; ++objIdx)
+		{
+			spheres.push_back(new Sphere(Point3D(position(rng), position(rng), position(rng)), radius(rng)));
+			planes.push_back(makeRandomPlane(rng));
+
+			objects.push_back(spheres.back());
+			objects.push_back(planes.back());
+		}
+
+		// The store keeps each type in the order added, so each hit's index identifies the object
+		Scene scene;
+		scene.addObjects(objects);
+		unsigned mismatches = 0;
+		for (unsigned packetIdx = 0; packetIdx < numPackets; ++packetIdx)
+		{
+			const RayPacket packet = makeRandomPacket(rng, Point3D(position(rng), position(rng), position(rng)));
+			PacketHits expected;
+			for (auto obj : objects)
+				obj->Object::getPacketIntersections(packet, expected, counters);
+
+			for (unsigned rayIdx = 0; rayIdx < packet.count; ++rayIdx)
+			{
+				Scene::Hit hit;
+				scene.getClosestIntersection(packet.origin, Vector3D(packet.dirX[rayIdx], packet.dirY[rayIdx], packet.dirZ[rayIdx]), hit, counters);
+				const Object* object = hit.type == Scene::PrimitiveType::Sphere ? spheres[hit.index]
+									 : (hit.type == Scene::PrimitiveType::Plane ? planes[hit.index] : nullptr);
+				if (object != expected.object[rayIdx] || memcmp(&hit.distance, &expected.distance[rayIdx], sizeof(float)) != 0)
+				{
+					++mismatches;
+					break;
+				}
+			}
+		}
+
+		for (auto obj : objects)
+			delete obj;
+		return mismatches;
+	}
+
+	// Traces random packets through a hierarchy over random spheres and a plane, and compares the closest object found for
+	// each ray by the packet traversal with the one found by traversing the hierarchy one ray at a time.
+	// Returns the number of packets where any ray's closest object differs.
+	unsigned verifyBVH(unsigned numPackets)
+	{
+		std::mt19937 rng(270);
+		RayCounters counters;	// Not reported, so that the checks' tests stay out of the totals
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f), radius(0.05f, 1.0f);
+		std::vector<Object*> objects;
+		objects.push_back(new Plane(Point3D(), Vector3D(0.0f, 0.0f, 1.0f), Vector3D(0.0f, 1.0f, 0.0f), 10.0f, 10.0f));
+		for (unsigned sphereIdx = 0; sphereIdx < 500; ++sphereIdx)
+			objects.push_back(new Sphere(Point3D(position(rng), position(rng), position(rng)), radius(rng)));
+
+		BVH bvh;
+		bvh.build(objects);
+		std::uniform_int_distribution<unsigned> objectIdx(1, (unsigned)objects.size() - 1);
+		unsigned mismatches = 0;
+		for (unsigned packetIdx = 0; packetIdx < numPackets; ++packetIdx)
+		{
+			const RayPacket packet = makeRandomPacket(rng, objects[objectIdx(rng)]->getWorldBounds().centre());
+			PacketHits hits;
+			bvh.getClosestPacketIntersections(packet, hits, counters);
+			for (unsigned rayIdx = 0; rayIdx < packet.count; ++rayIdx)
+			{
+				const Vector3D rayDir(packet.dirX[rayIdx], packet.dirY[rayIdx], packet.dirZ[rayIdx]);
+				if (bvh.getClosestIntersectedObject(packet.origin, rayDir, counters) != hits.object[rayIdx])
+				{
+					++mismatches;
+					break;
+				}
+			}
+		}
+
+		for (auto obj : objects)
+			delete obj;
+		return mismatches;
+	}
+
+	// Transforms random points and vectors by random affine matrices with Matrix3D::transformPoints and transformVectors,
+	// and compares the results with operator*, which must be bit-identical whichever instruction set the batched versions use.
+	// Transforming in place must give the same results as transforming to separate arrays.
+	// Params:
+	//	numMatrices			number of matrices to test (input)
+	//	pointMismatches		number of matrices where transformPoints gave different results (output)
+	//	vectorMismatches	number of matrices where transformVectors gave different results (output)
+	void verifyTransforms(unsigned numMatrices, unsigned& pointMismatches, unsigned& vectorMismatches)
+	{
+		std::mt19937 rng(270);
+		std::uniform_real_distribution<float> element(-2.0f, 2.0f), position(-10.0f, 10.0f);
+		std::uniform_int_distribution<unsigned> arraySize(1, 100);
+		pointMismatches = vectorMismatches = 0;
+		for (unsigned matrixIdx = 0; matrixIdx < numMatrices; ++matrixIdx)
+		{
+			Matrix3D matrix;
+			for (unsigned row = 0; row < 3; ++row)
+			{
+				for (unsigned col = 0; col < 3; ++col)
+					matrix(row, col) = element(rng);
+				matrix(row, 3) = position(rng);
+			}
+
+			// Sizes that aren't multiples of the SIMD width exercise the one-at-a-time remainder too
+			const unsigned count = arraySize(rng);
+			std::vector<float> x(count), y(count), z(count);
+			for (unsigned idx = 0; idx < count; ++idx)
+			{
+				x[idx] = position(rng);
+				y[idx] = position(rng);
+				z[idx] = position(rng);
+			}
+
+			for (const bool isPoint : { true, false })
+			{
+				std::vector<float> outX(count), outY(count), outZ(count);
+				std::vector<float> inPlaceX(x), inPlaceY(y), inPlaceZ(z);
+				if (isPoint)
+				{
+					matrix.transformPoints(x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+					matrix.transformPoints(inPlaceX.data(), inPlaceY.data(), inPlaceZ.data(), inPlaceX.data(), inPlaceY.data(), inPlaceZ.data(), count);
+				}
+				else
+				{
+					matrix.transformVectors(x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+					matrix.transformVectors(inPlaceX.data(), inPlaceY.data(), inPlaceZ.data(), inPlaceX.data(), inPlaceY.data(), inPlaceZ.data(), count);
+				}
+
+				bool match = memcmp(outX.data(), inPlaceX.data(), count * sizeof(float)) == 0 && memcmp(outY.data(), inPlaceY.data(), count * sizeof(float)) == 0
+						  && memcmp(outZ.data(), inPlaceZ.data(), count * sizeof(float)) == 0;
+				for (unsigned idx = 0; idx < count && match; ++idx)
+				{
+					float expected[3];
+					if (isPoint)
+					{
+						const Point3D pt = matrix * Point3D(x[idx], y[idx], z[idx]);
+						expected[0] = pt.x, expected[1] = pt.y, expected[2] = pt.z;
+					}
+					else
+					{
+						const Vector3D vec = matrix * Vector3D(x[idx], y[idx], z[idx]);
+						expected[0] = vec.x, expected[1] = vec.y, expected[2] = vec.z;
+					}
+					const float actual[3] = { outX[idx], outY[idx], outZ[idx] };
+					match = memcmp(actual, expected, sizeof(expected)) == 0;
+				}
+				if (!match)
+					++(isPoint ? pointMismatches : vectorMismatches);
+			}
+		}
+	}
+
+	// Feeds the resolution controller the frames the camera would render for numViews views, each refined progressively
+	// (tracing one pixel in 16, then the rest of one in 4, then the rest) and then held still for a few frames that trace
+	// nothing. Each ray costs msPerRay on top of a fixed cost per frame. Changing the resolution starts a new view, as
+	// it makes the camera render again. Returns the number of times the scale changed.
+	unsigned simulateFrames(ResolutionController& controller, double msPerRay, unsigned numViews)
+	{
+		const double fixedMs = 1.0;
+		unsigned changes = 0;
+		for (unsigned viewIdx = 0; viewIdx < numViews; ++viewIdx)
+		{
+			const unsigned pixels = controller.getResolutionX() * controller.getResolutionY();
+			const unsigned passRays[] = { pixels / 16, pixels / 4 - pixels / 16, pixels - pixels / 4 };
+			bool changed = false;
+			for (unsigned passIdx = 0; passIdx < 3 && !changed; ++passIdx)
+			{
+				const double traceMs = msPerRay * passRays[passIdx];
+				changed = controller.addFrame(fixedMs + traceMs, traceMs, passRays[passIdx]);
+			}
+			for (unsigned stillIdx = 0; stillIdx < 5 && !changed; ++stillIdx)
+				changed = controller.addFrame(fixedMs, 0.0, 0);
+			changes += changed ? 1 : 0;
+		}
+		return changes;
+	}
+
+	// Runs the resolution controller on simulated frame times (see simulateFrames), checking that it lowers the scale
+	// within a single view when frames take twice the target, then holds it, and raises it back to 1 when rays get cheaper.
+	// Params:
+	//	lowers, holds, raises	whether each check passed (output)
+	void verifyResolutionController(bool& lowers, bool& holds, bool& raises)
+	{
+		ResolutionController controller;
+		controller.setBaseResolution(256, 256);
+		controller.setTargetFrameMs(10.0);
+		controller.setEnabled(true);
+		const double slowMsPerRay = 19.0 / (256 * 256);		// A full frame at the base resolution takes 20 ms
+
+		lowers = simulateFrames(controller, slowMsPerRay, 1) == 1 && controller.getScale() < 1.0f;
+		holds = simulateFrames(controller, slowMsPerRay, 20) == 0;
+		const float heldScale = controller.getScale();
+		raises = simulateFrames(controller, slowMsPerRay / 8.0, 20) > 0 && controller.getScale() > heldScale && controller.getScale() == 1.0f;
+	}
+
+	// Applies many small random rotations to a Quaternion, as turning the camera does, and measures how far its axes drift
+	// from being orthonormal (unit length, perpendicular, and right-handed) along the way.
+	// Params:
+	//	numRotations	number of rotations to apply (input)
+	// Returns the largest error found in the axes' squared lengths, their dot products with each other, or their handedness.
+	float verifyQuaternion(unsigned numRotations)
+	{
+		std::mt19937 rng(270);
+		std::uniform_real_distribution<float> component(-1.0f, 1.0f), angle(-0.1f, 0.1f);
+
+		Quaternion orientation;
+		float maxError = 0.0f;
+		for (unsigned rotationIdx = 0; rotationIdx < numRotations; ++rotationIdx)
+		{
+			Vector3D axis(component(rng), component(rng), component(rng));
+			if (!(axis.magnitude() > 0.01f))
+				continue;
+			axis.normalise();
+			orientation.rotate(axis, angle(rng));
+
+			Vector3D xAxis, yAxis, zAxis;
+			orientation.getAxes(xAxis, yAxis, zAxis);
+			const float errors[] = {
+				fabsf(xAxis.dot(xAxis) - 1.0f), fabsf(yAxis.dot(yAxis) - 1.0f), fabsf(zAxis.dot(zAxis) - 1.0f),
+				fabsf(xAxis.dot(yAxis)), fabsf(yAxis.dot(zAxis)), fabsf(zAxis.dot(xAxis)),
+				fabsf(xAxis.cross(yAxis).dot(zAxis) - 1.0f)
+			};
+			for (float error : errors)
+				maxError = max(maxError, error);
+		}
+		return maxError;
+	}
+
+	// Publishes an increasing sequence of numbers through a TripleBuffer from one thread while another reads it, counting
+	// every value the reader receives that isn't newer than the one before (i.e. one that went backwards or was repeated
+	// although update() said it was new), and every value whose copies of the number disagree (i.e. one that was torn).
+	// Params:
+	//	numValues	number of values to publish (input)
+	//	received	number of values the reader received (output)
+	//	stale		number of received values that weren't newer than the previous one (output)
+	//	torn		number of received values that were changed while being read (output)
+	void verifyTripleBuffer(unsigned numValues, unsigned& received, unsigned& stale, unsigned& torn)
+	{
+		struct Value
+		{
+			unsigned	sequence[8];	// The same number in every element
+		};
+		TripleBuffer<Value> buffer;
+
+		std::thread producer([&buffer, numValues]()
+		{
+			for (unsigned sequence = 1; sequence <= numValues; ++sequence)
+			{
+				Value& value = buffer.getWriteBuffer();
+				for (unsigned& element : value.sequence)
+					element = sequence;
+				buffer.publish();
+
+				// Let the reader run between values even on a single core, so that the threads interleave often
+				if (sequence % 4 == 0)
+					std::this_thread::yield();
+			}
+		});
+
+		received = stale = torn = 0;
+		unsigned lastSequence = 0;
+		while (lastSequence < numValues)
+		{
+			if (!buffer.update())
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			const Value& value = buffer.getReadBuffer();
+			const unsigned sequence = value.sequence[0];
+			for (unsigned element : value.sequence)
+				torn += element != sequence ? 1 : 0;
+			stale += sequence <= lastSequence ? 1 : 0;
+			lastSequence = max(lastSequence, sequence);
+			++received;
+		}
+		producer.join();
+	}
+
+	// Intersects random packets with random spheres using each supported kernel, and compares the results with
+	// Sphere::getIntersection. Returns the number of mismatching packets.
+	unsigned verifyKernels(std::ostream& out)
+	{
+		std::mt19937 rng(270);
+		RayCounters counters;	// Not reported, so that the checks' tests stay out of the totals
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f), radius(0.1f, 5.0f);
+		std::uniform_int_distribution<unsigned> packetSize(1, RayPacket::c_maxSize);
+
+		const SphereKernels::Type types[] = { SphereKernels::Type::Scalar, SphereKernels::Type::SSE41, SphereKernels::Type::AVX2, SphereKernels::Type::AVX512 };
+		unsigned mismatches[4] = {};
+		const unsigned numPackets = 100000;
+		for (unsigned packetIdx = 0; packetIdx < numPackets; ++packetIdx)
+		{
+			RayPacket packet;
+			packet.origin = Point3D(position(rng), position(rng), position(rng));
+			packet.count = packetSize(rng);
+			for (unsigned rayIdx = 0; rayIdx < packet.count; ++rayIdx)
+			{
+				Vector3D dir(position(rng), position(rng), position(rng));
+				dir.normalise();
+				packet.dirX[rayIdx] = dir.x;
+				packet.dirY[rayIdx] = dir.y;
+				packet.dirZ[rayIdx] = dir.z;
+			}
+			packet.padDirections();
+
+			// Test two overlapping spheres, so that the closest-hit update is exercised too
+			const Sphere first(Point3D(position(rng), position(rng), position(rng)), radius(rng));
+			const Sphere second(Point3D(position(rng), position(rng), position(rng)), radius(rng));
+
+			PacketHits expected;
+			first.Object::getPacketIntersections(packet, expected, counters);
+			second.Object::getPacketIntersections(packet, expected, counters);
+
+			for (unsigned typeIdx = 0; typeIdx < 4; ++typeIdx)
+			{
+				if (!SphereKernels::isSupported(types[typeIdx]))
+					continue;
+
+				SphereKernels::setActiveType(types[typeIdx]);
+				PacketHits hits;
+				first.getPacketIntersections(packet, hits, counters);
+				second.getPacketIntersections(packet, hits, counters);
+				if (!hitsMatch(hits, expected, packet.count))
+					++mismatches[typeIdx];
+			}
+		}
+
+		unsigned totalMismatches = 0;
+		out << "{" << std::endl;
+		out << "  \"packets\": " << numPackets << "," << std::endl;
+		out << "  \"mismatches\": {";
+		bool first = true;
+		for (unsigned typeIdx = 0; typeIdx < 4; ++typeIdx)
+		{
+			if (!SphereKernels::isSupported(types[typeIdx]))
+				continue;
+
+			out << (first ? " " : ", ") << "\"" << SphereKernels::getName(types[typeIdx]) << "\": " << mismatches[typeIdx];
+			totalMismatches += mismatches[typeIdx];
+			first = false;
+		}
+		out << " }," << std::endl;
+
+		unsigned planePacketMismatches, planeStoreMismatches;
+		verifyPlanes(numPackets, planePacketMismatches, planeStoreMismatches);
+		out << "  \"plane_mismatches\": { \"packet\": " << planePacketMismatches << ", \"scene\": " << planeStoreMismatches << " }," << std::endl;
+		totalMismatches += planePacketMismatches + planeStoreMismatches;
+
+		const unsigned storeMismatches = verifyStore(numPackets / 10);
+		out << "  \"store_mismatches\": " << storeMismatches << "," << std::endl;
+		totalMismatches += storeMismatches;
+
+		const unsigned bvhMismatches = verifyBVH(numPackets / 10);
+		out << "  \"bvh_mismatches\": " << bvhMismatches << "," << std::endl;
+		totalMismatches += bvhMismatches;
+
+		unsigned pointMismatches, vectorMismatches;
+		verifyTransforms(numPackets / 10, pointMismatches, vectorMismatches);
+		out << "  \"transform_mismatches\": { \"instructions\": \"" << (CpuFeatures::get().avx2 ? "avx2" : "sse") << "\""
+			<< ", \"points\": " << pointMismatches << ", \"vectors\": " << vectorMismatches << " }," << std::endl;
+		totalMismatches += pointMismatches + vectorMismatches;
+
+		bool lowers, holds, raises;
+		verifyResolutionController(lowers, holds, raises);
+		out << "  \"resolution_controller\": { \"lowers\": " << (lowers ? "true" : "false") << ", \"holds\": " << (holds ? "true" : "false")
+			<< ", \"raises\": " << (raises ? "true" : "false") << " }," << std::endl;
+		totalMismatches += (lowers ? 0 : 1) + (holds ? 0 : 1) + (raises ? 0 : 1);
+
+		unsigned received, stale, torn;
+		verifyTripleBuffer(numPackets, received, stale, torn);
+		out << "  \"triple_buffer\": { \"published\": " << numPackets << ", \"received\": " << received
+			<< ", \"stale\": " << stale << ", \"torn\": " << torn << " }," << std::endl;
+		totalMismatches += stale + torn;
+
+		const unsigned numRotations = 10000;
+		const float quaternionError = verifyQuaternion(numRotations);
+		const bool orthonormal = quaternionError < 1e-5f;
+		out << "  \"quaternion\": { \"rotations\": " << numRotations << ", \"max_error\": " << quaternionError
+			<< ", \"orthonormal\": " << (orthonormal ? "true" : "false") << " }" << std::endl;
+		totalMismatches += orthonormal ? 0 : 1;
+
+		out << "}" << std::endl;
+		return totalMismatches;
+	}
+
+	// Returns the average time in nanoseconds taken by each call to op(idx), for idx from 0 to count - 1
+	template <typename Op>
+	double timeEach(unsigned count, Op op)
+	{
+		const unsigned repeats = 50;
+		const auto start = std::chrono::steady_clock::now();
+		for (unsigned repeat = 0; repeat < repeats; ++repeat)
+		{
+			for (unsigned idx = 0; idx < count; ++idx)
+				op(idx);
+		}
+		return getMsSince(start) * 1.0e6 / ((double)count * repeats);
+	}
+
+	// Times transforming arrays of points and vectors by the matrix, and multiplying it by an array of matrices of its type.
+	// Params:
+	//	matrix		the matrix to time (input)
+	//	points		the points to transform (also used as vectors) (input)
+	//	ns			average times for a point, a vector and a matrix product, in nanoseconds (output)
+	template <typename Matrix>
+	void timeMatrix(const Matrix& matrix, const std::vector<Point3D>& points, double (&ns)[3])
+	{
+		const unsigned count = (unsigned)points.size();
+		std::vector<Point3D> pointResults(count);
+		std::vector<Vector3D> vectors(count), vectorResults(count);
+		for (unsigned idx = 0; idx < count; ++idx)
+			vectors[idx] = points[idx].asVector();
+
+		// Matrix3D's product isn't const, so the left matrix is a copy
+		Matrix left = matrix;
+		const unsigned matrixCount = count / 16;
+		std::vector<Matrix> rights(matrixCount, matrix);
+		std::vector<decltype(left * matrix)> matrixResults(matrixCount);
+
+		ns[0] = timeEach(count, [&](unsigned idx) { pointResults[idx] = matrix * points[idx]; });
+		ns[1] = timeEach(count, [&](unsigned idx) { vectorResults[idx] = matrix * vectors[idx]; });
+		ns[2] = timeEach(matrixCount, [&](unsigned idx) { matrixResults[idx] = left * rights[idx]; });
+	}
+
+	// Times transforming the points (and the same values as vectors) by the matrix one at a time with operator*, and all at once
+	// from separate x, y and z arrays with transformPoints/transformVectors.
+	// Params:
+	//	matrix		the matrix to time (input)
+	//	points		the points to transform (input)
+	//	ns			average times per point for single points, batched points, single vectors and batched vectors, in nanoseconds (output)
+	void timeTransforms(const Matrix3D& matrix, const std::vector<Point3D>& points, double (&ns)[4])
+	{
+		const unsigned count = (unsigned)points.size();
+		std::vector<Point3D> pointResults(count);
+		std::vector<Vector3D> vectors(count), vectorResults(count);
+		std::vector<float> x(count), y(count), z(count), outX(count), outY(count), outZ(count);
+		for (unsigned idx = 0; idx < count; ++idx)
+		{
+			vectors[idx] = points[idx].asVector();
+			x[idx] = points[idx].x;
+			y[idx] = points[idx].y;
+			z[idx] = points[idx].z;
+		}
+
+		// Each batch is a block of points small enough to stay in the cache, like the single products
+		const unsigned batchSize = 256;
+		const unsigned numBatches = count / batchSize;
+		ns[0] = timeEach(count, [&](unsigned idx) { pointResults[idx] = matrix * points[idx]; });
+		ns[1] = timeEach(numBatches, [&](unsigned idx) { const unsigned first = idx * batchSize;
+			matrix.transformPoints(&x[first], &y[first], &z[first], &outX[first], &outY[first], &outZ[first], batchSize); }) / batchSize;
+		ns[2] = timeEach(count, [&](unsigned idx) { vectorResults[idx] = matrix * vectors[idx]; });
+		ns[3] = timeEach(numBatches, [&](unsigned idx) { const unsigned first = idx * batchSize;
+			matrix.transformVectors(&x[first], &y[first], &z[first], &outX[first], &outY[first], &outZ[first], batchSize); }) / batchSize;
+	}
+
+	// Times point, vector and matrix-matrix products with a general Matrix3D, and with a KindMatrix3D of each kind holding
+	// the same transform (a rotation plus a translation, or just the translation for the translation kind), writing the times as JSON.
+	// Matrix3D's products aren't inlined, so the projective kind (a general 4x4 product that is) is the baseline for the
+	// speedups, which then show what knowing the kind saves rather than what inlining does.
+	void benchmarkMatrices(std::ostream& out)
+	{
+		std::mt19937 rng(270);
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+		std::vector<Point3D> points(1 << 16);
+		for (Point3D& pt : points)
+			pt = Point3D(position(rng), position(rng), position(rng));
+
+		RigidMatrix3D rigid;
+		const float angle = 0.6f;
+		rigid(0, 0) = cosf(angle);
+		rigid(0, 1) = -sinf(angle);
+		rigid(1, 0) = sinf(angle);
+		rigid(1, 1) = cosf(angle);
+		rigid.setTranslation(Vector3D(1.0f, -2.0f, 3.0f));
+		TranslationMatrix3D translation;
+		translation.setTranslation(rigid.getTranslation());
+
+		const char* kinds[] = { "general", "translation", "rigid", "affine", "projective" };
+		double ns[5][3];
+		timeMatrix(rigid.toMatrix(), points, ns[0]);
+		timeMatrix(translation, points, ns[1]);
+		timeMatrix(rigid, points, ns[2]);
+		timeMatrix(AffineMatrix3D(rigid.toMatrix()), points, ns[3]);
+		timeMatrix(ProjectiveMatrix3D(rigid.toMatrix()), points, ns[4]);
+
+		const char* products[] = { "point", "vector", "matrix" };
+		out << "{" << std::endl;
+		out << "  \"matrix_ns\": {" << std::endl;
+		for (unsigned productIdx = 0; productIdx < 3; ++productIdx)
+		{
+			out << "    \"" << products[productIdx] << "\": {";
+			for (unsigned kindIdx = 0; kindIdx < 5; ++kindIdx)
+				out << (kindIdx == 0 ? " " : ", ") << "\"" << kinds[kindIdx] << "\": " << ns[kindIdx][productIdx];
+			out << " }" << (productIdx < 2 ? "," : "") << std::endl;
+		}
+		out << "  }," << std::endl;
+		out << "  \"speedup_vs_projective\": {" << std::endl;
+		for (unsigned productIdx = 0; productIdx < 3; ++productIdx)
+		{
+			out << "    \"" << products[productIdx] << "\": {";
+			for (unsigned kindIdx = 0; kindIdx < 4; ++kindIdx)
+				out << (kindIdx == 0 ? " " : ", ") << "\"" << kinds[kindIdx] << "\": " << ns[4][productIdx] / ns[kindIdx][productIdx];
+			out << " }" << (productIdx < 2 ? "," : "") << std::endl;
+		}
+		out << "  }," << std::endl;
+
+		double transformNs[4];
+		timeTransforms(rigid.toMatrix(), points, transformNs);
+		out << "  \"transform_ns\": {" << std::endl;
+		out << "    \"point\": { \"single\": " << transformNs[0] << ", \"batched\": " << transformNs[1] << " }," << std::endl;
+		out << "    \"vector\": { \"single\": " << transformNs[2] << ", \"batched\": " << transformNs[3] << " }" << std::endl;
+		out << "  }" << std::endl;
+		out << "}" << std::endl;
+	}
+
+	// Creates the same scene as the application, plus any extra spheres requested
+	void setupScene(std::vector<Object*>& objects, unsigned extraSpheres)
+	{
+		objects.push_back(new Plane(Point3D(), Vector3D(0.0f, 0.0f, 1.0f), Vector3D(0.0f, 1.0f, 0.0f), 10.0f, 10.0f));
+		objects.back()->setColour(Colour(255, 128, 128));
+
+		objects.push_back(new Sphere(Point3D(0.0f, 0.0f, 3.0f)));
+		objects.back()->setColour(Colour(128, 255, 128));
+
+		objects.push_back(new Sphere(Point3D(1.0f, 1.0f, 1.0f), 0.75f));
+		objects.back()->setColour(Colour(128, 128, 255));
+
+		// Use a fixed seed so that runs are comparable
+		std::mt19937 rng(270);
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f), radius(0.05f, 0.5f);
+		std::uniform_int_distribution<int> channel(0, 255);
+		for (unsigned sphereIdx = 0; sphereIdx < extraSpheres; ++sphereIdx)
+		{
+			objects.push_back(new Sphere(Point3D(position(rng), position(rng), position(rng) - 5.0f), radius(rng)));
+			objects.back()->setColour(Colour(channel(rng), channel(rng), channel(rng)));
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		std::cerr << "Usage: comp270-benchmark [--frames N] [--warmup N] [--threads N] [--resolution WxH] [--spheres N] [--kernel name] [--store objects|scene] [--no-bvh] [--progressive] [--scene file] [--save-scene file] [--image file] [--trace file.json] [--output file.json] [--verify] [--matrices]" << std::endl;
+		return 1;
+	}
+
+	if (options.verify)
+		return verifyKernels(std::cout) == 0 ? 0 : 1;
+	if (options.matrices)
+	{
+		benchmarkMatrices(std::cout);
+		return 0;
+	}
+
+	if (!options.kernel.empty())
+	{
+		SphereKernels::Type type;
+		if (!findKernelType(options.kernel, type) || !SphereKernels::setActiveType(type))
+		{
+			std::cerr << "Sphere kernel '" << options.kernel << "' is not available" << std::endl;
+			return 1;
+		}
+	}
+
+	// Load the scene from a file (timing each step), or create the built-in one
+	std::vector<Object*> objects;
+	Scene builtInScene;
+	SceneFile sceneFile;
+	const Scene* scene = &builtInScene;
+	SceneFile::CameraSettings cameraSettings;
+	double loadMs = 0.0, createObjectsMs = 0.0;
+	if (!options.scenePath.empty())
+	{
+		const auto loadStart = std::chrono::steady_clock::now();
+		if (!sceneFile.load(options.scenePath.c_str()))
+		{
+			std::cerr << "Scene loading error: " << sceneFile.getError() << std::endl;
+			return 1;
+		}
+		loadMs = getMsSince(loadStart);
+
+		// The file's store is traced directly unless the objects were asked for, in which case they are created (and timed)
+		if (!options.storeChosen)
+			options.useSceneStore = true;
+		if (!options.useSceneStore)
+		{
+			const auto createStart = std::chrono::steady_clock::now();
+			sceneFile.getScene().createObjects(objects);
+			createObjectsMs = getMsSince(createStart);
+		}
+
+		scene = &sceneFile.getScene();
+		cameraSettings = sceneFile.getCamera();
+	}
+	else
+	{
+		setupScene(objects, options.spheres);
+		builtInScene.addObjects(objects);
+	}
+
+	if (!options.saveScenePath.empty() && !SceneFile::saveBinary(options.saveScenePath.c_str(), cameraSettings, *scene))
+	{
+		std::cerr << "Couldn't write " << options.saveScenePath << std::endl;
+		return 1;
+	}
+
+	Camera camera;
+	camera.init(cameraSettings.position);
+	camera.setViewPlane(cameraSettings.viewPlaneDistance, cameraSettings.viewPlaneHalfWidth, cameraSettings.viewPlaneHalfHeight);
+	if (options.threads > 0)
+		camera.setRenderThreadCount(options.threads);
+	if (options.resolutionX > 0 && options.resolutionY > 0)
+		camera.setResolution(options.resolutionX, options.resolutionY);
+	camera.setUseBVH(options.useBVH);
+	camera.setProgressive(options.progressive);
+
+	std::vector<double> frameMs, transformMs, traceMs, shadeMs, presentMs;
+	std::vector<Colour> presentBuf;
+	double totalMs = 0.0;
+	unsigned long long totalRays = 0;
+	RayCounters rayCounters;
+	unsigned width = 0, height = 0;
+	const Image* lastImage = nullptr;
+
+	PROFILE_THREAD_NAME("Main");
+	for (unsigned frameIdx = 0; frameIdx < options.warmup + options.frames; ++frameIdx)
+	{
+		PROFILE_ZONE("Frame");
+
+		// Nudge the camera back and forth so that every frame has to be traced again
+		camera.translateX((frameIdx % 2 == 0) ? 0.01f : -0.01f);
+
+		const auto frameStart = std::chrono::steady_clock::now();
+		const Image& image = options.useSceneStore ? camera.updateScreenBuffer(*scene) : camera.updateScreenBuffer(objects);
+
+		// Stand in for presenting the image: copy it into a packed buffer with the rows flipped,
+		// as the application does when uploading it to a texture
+		const auto presentStart = std::chrono::steady_clock::now();
+		lastImage = &image;
+		width = image.width();
+		height = image.height();
+		presentBuf.resize(width * height);
+		{
+			PROFILE_ZONE("Upload");
+			for (unsigned j = 0; j < height; ++j)
+				memcpy(&presentBuf[(height - 1 - j) * width], image.data() + j * width, width * sizeof(Colour));
+		}
+		const double presentTime = getMsSince(presentStart);
+		const double frameTime = getMsSince(frameStart);
+
+		if (frameIdx < options.warmup)
+			continue;
+
+		const Camera::FrameTimings& timings = camera.getFrameTimings();
+		frameMs.push_back(frameTime);
+		transformMs.push_back(timings.transformMs);
+		traceMs.push_back(timings.traceMs);
+		shadeMs.push_back(timings.shadeMs);
+		presentMs.push_back(presentTime);
+		totalMs += frameTime;
+		totalRays += timings.raysCast;
+		rayCounters += timings.rayCounters;
+	}
+
+	// Frames that trace no rays (e.g. because ray generation is broken) would time nothing but overheads
+	if (options.frames > 0 && (totalRays == 0 || rayCounters.getPrimitiveTests() == 0))
+	{
+		std::cerr << "The benchmarked frames didn't trace any rays, so the timings would be meaningless" << std::endl;
+		return 1;
+	}
+
+	if (!options.imagePath.empty() && (lastImage == nullptr || !ImageWriter::write(options.imagePath.c_str(), *lastImage)))
+	{
+		std::cerr << "Couldn't write " << options.imagePath << std::endl;
+		return 1;
+	}
+
+	if (!options.tracePath.empty())
+	{
+		if (!Profiler::c_enabled)
+			std::cerr << "The profiler is disabled, so the trace will be empty (build with ENABLE_PROFILER defined to enable it)" << std::endl;
+		if (!Profiler::writeChromeTrace(options.tracePath.c_str()))
+		{
+			std::cerr << "Couldn't write " << options.tracePath << std::endl;
+			return 1;
+		}
+	}
+
+	std::ofstream file;
+	if (!options.outputPath.empty())
+	{
+		file.open(options.outputPath);
+		if (!file)
+		{
+			std::cerr << "Couldn't open " << options.outputPath << " for writing" << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& out = options.outputPath.empty() ? std::cout : file;
+
+	out << "{" << std::endl;
+	out << "  \"frames\": " << options.frames << "," << std::endl;
+	out << "  \"resolution\": [" << width << ", " << height << "]," << std::endl;
+	out << "  \"threads\": " << (options.threads > 0 ? options.threads : max(1u, std::thread::hardware_concurrency())) << "," << std::endl;
+	out << "  \"objects\": " << scene->numSpheres() + scene->numPlanes() << "," << std::endl;
+	out << "  \"scene\": { \"file\": \"" << escapeJson(options.scenePath) << "\", \"load_ms\": " << loadMs
+		<< ", \"create_objects_ms\": " << createObjectsMs << " }," << std::endl;
+	out << "  \"store\": \"" << (options.useSceneStore ? "scene" : "objects") << "\"," << std::endl;
+	out << "  \"bvh\": " << (options.useBVH ? "true" : "false") << "," << std::endl;
+	out << "  \"progressive\": " << (options.progressive ? "true" : "false") << "," << std::endl;
+	out << "  \"sphere_kernel\": \"" << SphereKernels::getName(SphereKernels::getActiveType()) << "\"," << std::endl;
+	out << "  "; writeStats(out, "frame_ms", getStats(frameMs)); out << "," << std::endl;
+	out << "  \"ray_counters\": "; rayCounters.writeJson(out); out << "," << std::endl;
+	out << "  \"rays_per_second\": " << (totalMs > 0.0 ? totalRays / (totalMs / 1000.0) : 0.0) << "," << std::endl;
+	out << "  \"phases_ms\": {" << std::endl;
+	out << "    "; writeStats(out, "transform", getStats(transformMs)); out << "," << std::endl;
+	out << "    "; writeStats(out, "trace", getStats(traceMs)); out << "," << std::endl;
+	out << "    "; writeStats(out, "shade", getStats(shadeMs)); out << "," << std::endl;
+	out << "    "; writeStats(out, "present", getStats(presentMs)); out << std::endl;
+	out << "  }" << std::endl;
+	out << "}" << std::endl;
+
+	for (auto obj : objects)
+		delete obj;
+
+	return 0;
+}
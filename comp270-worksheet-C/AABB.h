@@ -0,0 +1,68 @@
+#pragma once
+#include "Point3D.h"
+
+// An axis-aligned bounding box, given by its minimum and maximum corners.
+// A default-constructed box is empty (its minimum is greater than its maximum), so expanding it by anything gives that thing's bounds.
+class AABB
+{
+public:
+	AABB() : minCorner(FLT_MAX, FLT_MAX, FLT_MAX), maxCorner(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+	AABB(const Point3D& minCorner_, const Point3D& maxCorner_) : minCorner(minCorner_), maxCorner(maxCorner_) {}
+
+	Point3D minCorner, maxCorner;
+
+	// Returns true if the box contains nothing
+	bool isEmpty() const
+	{
+		return minCorner.x > maxCorner.x || minCorner.y > maxCorner.y || minCorner.z > maxCorner.z;
+	}
+
+	// Grow the box to enclose the given point
+	void expand(const Point3D& pt)
+	{
+		minCorner = Point3D(fminf(minCorner.x, pt.x), fminf(minCorner.y, pt.y), fminf(minCorner.z, pt.z));
+		maxCorner = Point3D(fmaxf(maxCorner.x, pt.x), fmaxf(maxCorner.y, pt.y), fmaxf(maxCorner.z, pt.z));
+	}
+
+	// Grow the box to enclose another box
+	void expand(const AABB& other)
+	{
+		minCorner = Point3D(fminf(minCorner.x, other.minCorner.x), fminf(minCorner.y, other.minCorner.y), fminf(minCorner.z, other.minCorner.z));
+		maxCorner = Point3D(fmaxf(maxCorner.x, other.maxCorner.x), fmaxf(maxCorner.y, other.maxCorner.y), fmaxf(maxCorner.z, other.maxCorner.z));
+	}
+
+	// Get the point in the middle of the box
+	Point3D centre() const
+	{
+		return Point3D((minCorner.x + maxCorner.x) * 0.5f, (minCorner.y + maxCorner.y) * 0.5f, (minCorner.z + maxCorner.z) * 0.5f);
+	}
+
+	// Get the total area of the box's faces (zero if it is empty)
+	float surfaceArea() const
+	{
+		if (isEmpty())
+			return 0.0f;
+
+		Vector3D size = maxCorner - minCorner;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	// Returns true if the ray enters the box before travelling maxDist along it.
+	// Params:
+	//	raySrc		starting point of the ray (input)
+	//	invRayDir	reciprocal of each component of the ray's direction (input)
+	//	maxDist		distance along the ray beyond which intersections are ignored (input)
+	//	entryDist	distance along the ray at which it enters the box (output)
+	bool getIntersection(const Point3D& raySrc, const Vector3D& invRayDir, float maxDist, float& entryDist) const
+	{
+		float tx1 = (minCorner.x - raySrc.x) * invRayDir.x, tx2 = (maxCorner.x - raySrc.x) * invRayDir.x;
+		float ty1 = (minCorner.y - raySrc.y) * invRayDir.y, ty2 = (maxCorner.y - raySrc.y) * invRayDir.y;
+		float tz1 = (minCorner.z - raySrc.z) * invRayDir.z, tz2 = (maxCorner.z - raySrc.z) * invRayDir.z;
+
+		float tEnter = fmaxf(fmaxf(fminf(tx1, tx2), fminf(ty1, ty2)), fminf(tz1, tz2));
+		float tExit = fminf(fminf(fmaxf(tx1, tx2), fmaxf(ty1, ty2)), fmaxf(tz1, tz2));
+
+		entryDist = tEnter;
+		return tEnter <= tExit && tExit >= 0.0f && tEnter < maxDist;
+	}
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+// A resizable array of plain values (floats, ints etc.) whose storage is aligned for SIMD loads and stores.
+// Shrinking keeps the existing storage, and growing at least doubles it, so repeated resizes rarely reallocate.
+template <typename T, size_t Alignment = 64>
+class AlignedArray
+{
+public:
+	AlignedArray() {}
+	~AlignedArray() { _aligned_free(m_data); }
+
+	AlignedArray(const AlignedArray&) = delete;
+	AlignedArray& operator=(const AlignedArray&) = delete;
+
+	size_t	size() const { return m_size; }
+	size_t	capacity() const { return m_capacity; }
+	bool	empty() const { return m_size == 0; }
+
+	T*			data() { return m_data; }
+	const T*	data() const { return m_data; }
+
+	T&			operator[](size_t idx) { return m_data[idx]; }
+	const T&	operator[](size_t idx) const { return m_data[idx]; }
+
+	// Change the number of elements, keeping the values of those that remain (new elements are uninitialised).
+	// Throws std::bad_alloc if the storage can't be allocated, leaving the array unchanged.
+	void resize(size_t size)
+	{
+		if (size > m_capacity)
+		{
+			size_t capacity = max(size, 2 * m_capacity);
+			if (capacity > SIZE_MAX / sizeof(T))
+				throw std::bad_alloc();
+			T* data = static_cast<T*>(_aligned_malloc(capacity * sizeof(T), Alignment));
+			if (data == nullptr)
+				throw std::bad_alloc();
+			if (m_data != nullptr)
+			{
+				memcpy(data, m_data, m_size * sizeof(T));
+				_aligned_free(m_data);
+			}
+			m_data = data;
+			m_capacity = capacity;
+		}
+		m_size = size;
+	}
+
+	// Add an element to the end of the array
+	void push_back(T value)
+	{
+		resize(m_size + 1);
+		m_data[m_size - 1] = value;
+	}
+
+	// Remove all elements (keeping the storage)
+	void clear() { m_size = 0; }
+
+private:
+	T*		m_data = nullptr;
+	size_t	m_size = 0;
+	size_t	m_capacity = 0;
+};
@@ -1,14 +1,24 @@
 #include "stdafx.h"
 #include "Application.h"
 #include "Object.h"
+#include "ImageWriter.h"
+#include "Profiler.h"
+#include <SDL_test_font.h>
 
 // Constructor -- initialise application-specific data here
-Application::Application()
+// Params:
+//	scenePath	File to load the scene from, or null to use the scene set up in setupScene
+Application::Application(const char* scenePath)
 {
+	if (scenePath != nullptr)
+		m_scenePath = scenePath;
+	m_cameraState.resolutionX = m_camera.getResolutionX();
+	m_cameraState.resolutionY = m_camera.getResolutionY();
 }
 
 Application::~Application()
 {
+	stopRenderThread();
 	for (auto obj : m_objects)
 	{
 		if (obj != nullptr)
@@ -24,29 +34,173 @@ bool Application::run()
 	if (!initSDL())
 		return false;
 
-	setupScene();
+	if (!setupScene())
+	{
+		shutdownSDL();
+		return false;
+	}
 
-	// Main loop
+	// Main loop: the ray tracing happens on the render thread, so this thread only handles input and draws finished frames,
+	// and responds to input however long each frame takes to trace
+	PROFILE_THREAD_NAME("Main");
+	startRenderThread();
 	m_quit = false;
 	while (!m_quit)
 	{
-		// Process events
+		// Sleep until an event arrives (either input, or the render thread announcing a new frame), then handle any others
 		SDL_Event ev;
-		while (SDL_PollEvent(&ev))
+		if (SDL_WaitEvent(&ev))
 		{
 			processEvent(ev);
 		}
+		{
+			PROFILE_ZONE("Events");
+			while (SDL_PollEvent(&ev))
+			{
+				processEvent(ev);
+			}
+		}
 
-		// Render
-		render();
-		SDL_RenderPresent(m_renderer);
+		// Pass any changes to the camera on to the render thread
+		if (m_cameraStateChanged)
+			sendCameraState();
+
+		// Draw and present the latest frame, if there is anything new to show.
+		// In fixed rate mode this waits for the frame's slot first, so the latest frame at that point is the one drawn.
+		if (m_frames.hasNew() || m_redrawWindow)
+		{
+			m_presentPacer.waitForNextPresent();
+			const bool newFrame = m_frames.hasNew();
+			if (drawLatestFrame())
+				presentFrame(newFrame);
+		}
 	}
 
 	// Shutdown
+	stopRenderThread();
 	shutdownSDL();
+	return writeStats() && writeTrace();
+}
+
+// Render the scene without opening a window, writing the camera's image to a PPM or PNG file (chosen by the extension).
+// If more than one frame is rendered, each is written to its own file, numbered before the extension (e.g. image_0001.ppm).
+// Return true if every frame is written successfully
+bool Application::renderToFile(const char* imagePath, unsigned frames)
+{
+	if (!setupScene())
+		return false;
+
+	// Every frame should be the complete image
+	m_cameraState.progressive = false;
+	applyCameraState(m_cameraState);
+
+	// Frame numbers go before the file extension (if there is one)
+	const std::string path = imagePath;
+	const size_t directoryEnd = path.find_last_of("/\\");
+	size_t extensionPos = path.find_last_of('.');
+	if (extensionPos == std::string::npos || (directoryEnd != std::string::npos && extensionPos < directoryEnd))
+		extensionPos = path.size();
+	for (unsigned frameIdx = 0; frameIdx < frames; ++frameIdx)
+	{
+		const Image& cameraBuf = updateCameraImage();
+		if (!m_camera.getFrameTimings().imageReused)
+		{
+			m_statsTimings = m_camera.getFrameTimings();
+			++m_framesTraced;
+		}
+
+		std::string framePath = path;
+		if (frames > 1)
+		{
+			char frameNumber[16];
+			snprintf(frameNumber, sizeof(frameNumber), "_%04u", frameIdx);
+			framePath.insert(extensionPos, frameNumber);
+		}
+
+		if (!ImageWriter::write(framePath.c_str(), cameraBuf))
+		{
+			std::cout << "Couldn't write " << framePath << std::endl;
+			return false;
+		}
+	}
+
+	return writeStats() && writeTrace();
+}
+
+// Write the ray counters to the stats file as JSON, if one was requested
+// Return false if the file can't be written
+bool Application::writeStats()
+{
+	if (m_statsPath.empty())
+		return true;
+
+	std::ofstream file(m_statsPath);
+	file << "{" << std::endl;
+	file << "  \"frames_traced\": " << m_framesTraced << "," << std::endl;
+	file << "  \"totals\": "; RayStats::getTotals().writeJson(file); file << "," << std::endl;
+	file << "  \"last_frame\": "; m_statsTimings.rayCounters.writeJson(file); file << "," << std::endl;
+	file << "  \"present\": "; m_presentPacer.writeJson(file); file << std::endl;
+	file << "}" << std::endl;
+	if (!file)
+	{
+		std::cout << "Couldn't write " << m_statsPath << std::endl;
+		return false;
+	}
 	return true;
 }
 
+// Write the zones recorded by the profiler to the trace file, if one was requested
+// Return false if the file can't be written
+bool Application::writeTrace()
+{
+	if (m_tracePath.empty())
+		return true;
+
+	if (!Profiler::c_enabled)
+		std::cout << "The profiler is disabled, so the trace will be empty (build with ENABLE_PROFILER defined to enable it)" << std::endl;
+
+	if (!Profiler::writeChromeTrace(m_tracePath.c_str()))
+	{
+		std::cout << "Couldn't write " << m_tracePath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Set the resolution of the image rendered by the camera; the window shows it scaled to fit.
+// The camera keeps its buffers and the window keeps its texture when the resolution goes down, so it can be changed every frame.
+// With dynamic resolution enabled, this is the highest resolution that will be used.
+// Params:
+//	resolutionX, resolutionY	The number of pixels in the x and y directions
+void Application::setRenderResolution(unsigned resolutionX, unsigned resolutionY)
+{
+	m_cameraState.resolutionX = max(1u, resolutionX);
+	m_cameraState.resolutionY = max(1u, resolutionY);
+	m_cameraStateChanged = true;
+}
+
+// Enable or disable dynamic resolution, which lowers the resolution when frames take longer than the target time
+// and raises it again (up to the resolution set by setRenderResolution) when they are quicker.
+// Params:
+//	enabled			Whether to adjust the resolution
+//	targetFrameMs	The time each frame should take to render, in milliseconds
+void Application::setDynamicResolution(bool enabled, double targetFrameMs)
+{
+	m_cameraState.dynamicResolution = enabled;
+	m_cameraState.targetFrameMs = targetFrameMs;
+	m_cameraStateChanged = true;
+}
+
+// Scale the highest resolution of the rendered image by the given factor in both directions,
+// keeping it between c_minResolution and the size of the window
+void Application::scaleResolution(float scale)
+{
+	const unsigned resolutionX = (unsigned)(m_cameraState.resolutionX * scale + 0.5f);
+	const unsigned resolutionY = (unsigned)(m_cameraState.resolutionY * scale + 0.5f);
+	setRenderResolution(min(max(resolutionX, c_minResolution), (unsigned)c_windowWidth),
+						min(max(resolutionY, c_minResolution), (unsigned)c_windowHeight));
+}
+
 // Initialise the required parts of the SDL library
 // Return true if initialisation is successful, or false if initialisation fails
 bool Application::initSDL()
@@ -64,7 +218,11 @@ bool Application::initSDL()
 		return false;
 	}
 
-	m_renderer = SDL_CreateRenderer(m_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+	// Only vsync pacing waits for the display to refresh; the other modes pace presents themselves
+	Uint32 rendererFlags = SDL_RENDERER_ACCELERATED;
+	if (m_presentPacer.usesVSync())
+		rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+	m_renderer = SDL_CreateRenderer(m_window, -1, rendererFlags);
 	if (m_renderer == nullptr)
 	{
 		std::cout << "SDL_CreateRenderer Error: " << SDL_GetError() << std::endl;
@@ -78,12 +236,32 @@ bool Application::initSDL()
 		return false;
 	}
 
+	m_frameReadyEvent = SDL_RegisterEvents(1);
+	if (m_frameReadyEvent == (Uint32)-1)
+	{
+		std::cout << "SDL_RegisterEvents Error: " << SDL_GetError() << std::endl;
+		return false;
+	}
+
 	return true;
 }
 
 // Shutdown the SDL library
 void Application::shutdownSDL()
 {
+	// The textures belong to the renderer, so they must be destroyed before it is
+	if (m_screenBuf)
+	{
+		SDL_DestroyTexture(m_screenBuf);
+		m_screenBuf = nullptr;
+	}
+
+	if (m_cameraTexture)
+	{
+		SDL_DestroyTexture(m_cameraTexture);
+		m_cameraTexture = nullptr;
+	}
+
 	if (m_renderer)
 	{
 		SDL_DestroyRenderer(m_renderer);
@@ -96,45 +274,110 @@ void Application::shutdownSDL()
 		m_window = nullptr;
 	}
 
-	if (m_screenBuf)
-	{
-		SDL_DestroyTexture(m_screenBuf);
-		m_screenBuf = nullptr;
-	}
-
 	SDL_Quit();
 }
 
 // Process a single event
 void Application::processEvent(const SDL_Event &ev)
 {
+	if (ev.type == m_frameReadyEvent)
+	{
+		// The frame itself is picked up by drawLatestFrame
+		m_frameEventPending = false;
+		return;
+	}
+
 	switch (ev.type)
 	{
 	case SDL_QUIT:
 		m_quit = true;
 		break;
 
+	case SDL_WINDOWEVENT:
+		// The window may have been uncovered or resized, so draw it again even if the image hasn't changed
+		m_redrawWindow = true;
+		break;
+
 	case SDL_KEYDOWN:
 	{
 		bool shiftMod = SDL_GetModState() & KMOD_SHIFT;
+		Point3D& position = m_cameraState.position;
+		Quaternion& orientation = m_cameraState.orientation;
 		if (ev.key.keysym.sym == SDLK_ESCAPE)
 			m_quit = true;
 		else if (ev.key.keysym.sym == SDLK_a)
-			shiftMod ? m_camera.rotateY(-0.1f) : m_camera.translateX(-1.0f);
+		{
+			if (shiftMod)
+				orientation.rotate(Vector3D(0.0f, 1.0f, 0.0f), 0.1f);
+			else
+				position.x -= 1.0f;
+		}
 		else if (ev.key.keysym.sym == SDLK_d)
-			shiftMod ? m_camera.rotateY(0.1f) : m_camera.translateX(1.0f);
+		{
+			if (shiftMod)
+				orientation.rotate(Vector3D(0.0f, 1.0f, 0.0f), -0.1f);
+			else
+				position.x += 1.0f;
+		}
 		else if (ev.key.keysym.sym == SDLK_s)
-			shiftMod ? m_camera.rotateX(0.1f) : m_camera.translateY(-1.0f);
+		{
+			if (shiftMod)
+				orientation.rotate(Vector3D(1.0f, 0.0f, 0.0f), -0.1f);
+			else
+				position.y -= 1.0f;
+		}
 		else if (ev.key.keysym.sym == SDLK_w)
-			shiftMod ? m_camera.rotateX(-0.1f) : m_camera.translateY(1.0f);
+		{
+			if (shiftMod)
+				orientation.rotate(Vector3D(1.0f, 0.0f, 0.0f), 0.1f);
+			else
+				position.y += 1.0f;
+		}
 		else if (ev.key.keysym.sym == SDLK_q)
-			shiftMod ? m_camera.rotateZ(-0.1f) : m_camera.translateZ(-1.0f);
+		{
+			if (shiftMod)
+				orientation.rotate(Vector3D(0.0f, 0.0f, 1.0f), -0.1f);
+			else
+				position.z -= 1.0f;
+		}
 		else if (ev.key.keysym.sym == SDLK_e)
-			shiftMod ? m_camera.rotateZ(0.1f) : m_camera.translateZ(1.0f);
+		{
+			if (shiftMod)
+				orientation.rotate(Vector3D(0.0f, 0.0f, 1.0f), 0.1f);
+			else
+				position.z += 1.0f;
+		}
 		else if (ev.key.keysym.sym == SDLK_UP)
-			m_camera.zoom(0.1f);
+			m_cameraState.viewPlaneDistance += 0.1f;
 		else if (ev.key.keysym.sym == SDLK_DOWN)
-			m_camera.zoom(-0.1f);
+			m_cameraState.viewPlaneDistance = max(1.0f, m_cameraState.viewPlaneDistance - 0.1f);
+		else if (ev.key.keysym.sym == SDLK_o)
+			m_cameraState.useSceneStore = !m_cameraState.useSceneStore;
+		else if (ev.key.keysym.sym == SDLK_p)
+			m_cameraState.progressive = !m_cameraState.progressive;
+		else if (ev.key.keysym.sym == SDLK_MINUS)
+			scaleResolution(0.8f);
+		else if (ev.key.keysym.sym == SDLK_EQUALS)
+			scaleResolution(1.25f);
+		else if (ev.key.keysym.sym == SDLK_r)
+			setDynamicResolution(!m_cameraState.dynamicResolution, m_cameraState.targetFrameMs);
+		else if (ev.key.keysym.sym == SDLK_u)
+		{
+			m_useStreamingUpload = !m_useStreamingUpload;
+			m_redrawWindow = true;
+			break;
+		}
+		else if (ev.key.keysym.sym == SDLK_i)
+		{
+			m_showStats = !m_showStats;
+			m_redrawWindow = true;
+			break;
+		}
+		else
+			break;
+
+		// Every key not handled above changes the camera
+		m_cameraStateChanged = true;
 		break;
 	}
 	default:
@@ -143,41 +386,256 @@ void Application::processEvent(const SDL_Event &ev)
 }
 
 // Add the camera and renderable objects to the scene
-void Application::setupScene()
+// Return false if the scene file can't be loaded
+bool Application::setupScene()
+{
+	if (!m_scenePath.empty())
+	{
+		if (!m_sceneFile.load(m_scenePath.c_str()))
+		{
+			std::cout << "Scene loading error: " << m_sceneFile.getError() << std::endl;
+			return false;
+		}
+
+		const SceneFile::CameraSettings& settings = m_sceneFile.getCamera();
+		m_camera.init(settings.position);
+		m_camera.setViewPlane(settings.viewPlaneDistance, settings.viewPlaneHalfWidth, settings.viewPlaneHalfHeight);
+		// The file's store is traced directly (for a binary file, straight from the mapped file), so no objects are created
+		// unless the user switches to tracing them
+		m_sceneStore = &m_sceneFile.getScene();
+		m_cameraState.useSceneStore = true;
+	}
+	else
+	{
+		m_camera.init(Point3D(0.0f, 0.0f, 20.0f));
+
+		m_objects.push_back(new Plane(Point3D(), Vector3D(0.0f, 0.0f, 1.0f), Vector3D(0.0f, 1.0f, 0.0f), 10.0f, 10.0f));
+		m_objects[0]->setColour(Colour(255, 128, 128));
+
+		m_objects.push_back(new Sphere(Point3D(0.0f, 0.0f, 3.0f)));
+		m_objects[1]->setColour(Colour(128, 255, 128));
+
+		m_objects.push_back(new Sphere(Point3D(1.0f, 1.0f, 1.0f), 0.75f));
+		m_objects[2]->setColour(Colour(128, 128, 255));
+
+		// The objects don't change after this, so the scene store only needs filling once
+		m_scene.clear();
+		m_scene.addObjects(m_objects);
+		m_sceneStore = &m_scene;
+	}
+
+	// The user's changes to the camera start from where the scene puts it
+	m_cameraState.position = m_camera.getPosition();
+	m_cameraState.orientation = m_camera.getOrientation();
+	m_cameraState.viewPlaneDistance = m_camera.getViewPlaneDistance();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Start tracing frames on the render thread, beginning with the current camera state
+void Application::startRenderThread()
+{
+	m_stopRendering = false;
+	m_cameraStateChanged = false;
+	m_cameraStates.getWriteBuffer() = m_cameraState;
+	m_cameraStates.publish();
+	m_renderThread = std::thread(&Application::renderLoop, this);
+}
+
+// Ask the render thread to finish, and wait for it to exit
+void Application::stopRenderThread()
+{
+	if (!m_renderThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_renderMutex);
+		m_stopRendering = true;
+	}
+	m_wakeRenderThread.notify_one();
+	m_renderThread.join();
+}
+
+// Send a copy of the camera state to the render thread, replacing any it hasn't picked up yet
+void Application::sendCameraState()
+{
+	m_cameraStates.getWriteBuffer() = m_cameraState;
+	m_cameraStates.publish();
+	m_cameraStateChanged = false;
+
+	// Taking the lock makes sure the render thread is either asleep or hasn't yet checked for a new state, so it can't miss this
+	{
+		std::lock_guard<std::mutex> lock(m_renderMutex);
+	}
+	m_wakeRenderThread.notify_one();
+}
+
+// Main loop for the render thread: apply the latest camera state and trace a frame, sleeping while there's nothing new to trace
+void Application::renderLoop()
+{
+	PROFILE_THREAD_NAME("Render");
+	bool idle = false;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_renderMutex);
+			if (idle)
+				m_wakeRenderThread.wait(lock, [&] { return m_stopRendering || m_cameraStates.hasNew(); });
+			if (m_stopRendering)
+				break;
+		}
+
+		if (m_cameraStates.update())
+			applyCameraState(m_cameraStates.getReadBuffer());
+		idle = !renderFrame();
+	}
+}
+
+// Update the camera's image from either the scene store or the objects, as chosen by the applied camera state.
+// The objects for a loaded scene file are only created the first time they are traced.
+const Image& Application::updateCameraImage()
 {
-	m_camera.init(Point3D(0.0f, 0.0f, 20.0f));
+	if (m_appliedState.useSceneStore)
+		return m_camera.updateScreenBuffer(*m_sceneStore);
 
-	m_objects.push_back(new Plane(Point3D(), Vector3D(0.0f, 0.0f, 1.0f), Vector3D(0.0f, 1.0f, 0.0f), 10.0f, 10.0f));
-	m_objects[0]->m_colour = Colour(255, 128, 128);
+	if (m_objects.empty() && m_sceneStore == &m_sceneFile.getScene())
+		m_sceneFile.getScene().createObjects(m_objects);
+	return m_camera.updateScreenBuffer(m_objects);
+}
+
+// Render the scene (via the camera) and hand the image over to the main thread
+// Returns false if nothing had changed, so the previous image was still up to date
+bool Application::renderFrame()
+{
+	PROFILE_ZONE("Render");
+	const auto updateStart = std::chrono::steady_clock::now();
+	const Image& cameraBuf = updateCameraImage();
+	const double updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updateStart).count();
+	const Camera::FrameTimings& timings = m_camera.getFrameTimings();
+
+	// Change the resolution for the next frame if this one took too long (or was quick enough to afford more pixels).
+	// This image is still drawn at its own resolution, stretched to fill the window like every other.
+	if (m_resolutionController.addFrame(updateMs, timings.traceMs, timings.raysCast))
+		m_camera.setResolution(m_resolutionController.getResolutionX(), m_resolutionController.getResolutionY());
 
-	m_objects.push_back(new Sphere(Point3D(0.0f, 0.0f, 3.0f)));
-	m_objects[1]->m_colour = Colour(128, 255, 128);
+	if (!cameraBuf.isInitialised() || timings.imageReused)
+		return false;
+	m_statsTimings = timings;
+	++m_framesTraced;
+
+	// Copy the image into the frame the main thread isn't using (reusing its storage), and publish it
+	RenderedFrame& frame = m_frames.getWriteBuffer();
+	{
+		PROFILE_ZONE("Copy image");
+		frame.image = cameraBuf;
+	}
+	frame.timings = timings;
+	frame.updateMs = updateMs;
+	frame.dynamicResolution = m_resolutionController.isEnabled();
+	frame.useSceneStore = m_appliedState.useSceneStore;
+	frame.finishedTime = std::chrono::steady_clock::now();
+	m_frames.publish();
 
-	m_objects.push_back(new Sphere(Point3D(1.0f, 1.0f, 1.0f), 0.75f));
-	m_objects[2]->m_colour = Colour(128, 128, 255);
+	// Wake the main thread, unless it already has a wake-up event waiting
+	if (!m_frameEventPending.exchange(true))
+	{
+		SDL_Event ev;
+		SDL_zero(ev);
+		ev.type = m_frameReadyEvent;
+		SDL_PushEvent(&ev);
+	}
+	return true;
 }
 
-// Render the scene (via the camera)
-void Application::render()
+// Make the camera and resolution controller match the given state, only changing the settings that differ
+// from the last state applied (so that unchanged settings don't restart progressive refinement)
+void Application::applyCameraState(const CameraState& state)
 {
+	const CameraState& last = m_appliedState;
+	const bool all = !m_cameraStateApplied;
+	if (all || state.position.x != last.position.x || state.position.y != last.position.y || state.position.z != last.position.z)
+		m_camera.setPosition(state.position);
+	if (all || state.orientation != last.orientation)
+		m_camera.setOrientation(state.orientation);
+	if (all || state.viewPlaneDistance != last.viewPlaneDistance)
+		m_camera.setViewPlane(state.viewPlaneDistance, m_camera.getViewPlaneHalfWidth(), m_camera.getViewPlaneHalfHeight());
+	if (all || state.progressive != last.progressive)
+		m_camera.setProgressive(state.progressive);
+
+	if (all || state.resolutionX != last.resolutionX || state.resolutionY != last.resolutionY
+		|| state.dynamicResolution != last.dynamicResolution || state.targetFrameMs != last.targetFrameMs)
+	{
+		m_resolutionController.setBaseResolution(state.resolutionX, state.resolutionY);
+		m_resolutionController.setTargetFrameMs(state.targetFrameMs);
+		if (all || state.dynamicResolution != last.dynamicResolution)
+			m_resolutionController.setEnabled(state.dynamicResolution);
+		m_camera.setResolution(m_resolutionController.getResolutionX(), m_resolutionController.getResolutionY());
+	}
+
+	m_appliedState = state;
+	m_cameraStateApplied = true;
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Draw the latest frame finished by the render thread, if there is a new one (or the window needs drawing again)
+// Returns false if there was nothing new to draw, so the window was left as it is
+bool Application::drawLatestFrame()
+{
+	if (!m_frames.update() && !m_redrawWindow)
+		return false;
+
+	const Image& image = m_frames.getReadBuffer().image;
+	if (!image.isInitialised())
+		return false;
+
+	if (m_useStreamingUpload)
+		renderStreaming(image);
+	else
+		renderPerPixel(image);
+	drawStatsOverlay();
+	m_redrawWindow = false;
+	return true;
+}
+
+// Show the frame drawn by drawLatestFrame, measuring how long the present takes and how long ago the frame was finished
+// Params:
+//	newFrame	True if the frame hasn't been presented before (rather than being drawn again)
+void Application::presentFrame(bool newFrame)
+{
+	PROFILE_ZONE("Present");
+	const auto presentStart = std::chrono::steady_clock::now();
+	SDL_RenderPresent(m_renderer);
+	const auto presentEnd = std::chrono::steady_clock::now();
+
+	const double presentMs = std::chrono::duration<double, std::milli>(presentEnd - presentStart).count();
+	const double latencyMs = std::chrono::duration<double, std::milli>(presentEnd - m_frames.getReadBuffer().finishedTime).count();
+	m_presentPacer.addPresent(presentMs, newFrame ? latencyMs : -1.0);
+}
+
+// Draw the camera image by filling a rectangle for each pixel
+void Application::renderPerPixel(const Image& cameraBuf)
+{
+	PROFILE_ZONE("Upload");
+
 	// Convert the image created by the camera to an SDL_Texture
 	// that can be rendered directly to the window.
-	const Image& cameraBuf = m_camera.updateScreenBuffer(m_objects);
-	if (cameraBuf.isInitialised() && m_screenBuf != nullptr)
+	if (m_screenBuf != nullptr)
 	{
 		// Point the renderer to the 'screen buffer' texture.
 		SDL_SetRenderTarget(m_renderer, m_screenBuf);
 
 		// Copy the data from the camera image to the screen texture,
 		// accounting for the resolution and flipped y-axis
-		static const float x_step = (float)c_windowWidth / (float)cameraBuf.width();
-		static const float y_step = (float)c_windowHeight / (float)cameraBuf.height();
-		static SDL_FRect rect;
+		const float x_step = (float)c_windowWidth / (float)cameraBuf.width();
+		const float y_step = (float)c_windowHeight / (float)cameraBuf.height();
+		SDL_FRect rect;
 		rect.x = 0.0f;
 		rect.w = x_step;
 		rect.h = y_step;
 
-		static const int iEnd = cameraBuf.width(), jStart = cameraBuf.height() - 1;
+		const int iEnd = cameraBuf.width(), jStart = cameraBuf.height() - 1;
 		for (int i = 0; i < iEnd; ++i)
 		{
 			rect.y = 0.0f;
@@ -194,15 +652,193 @@ void Application::render()
 		// Draw the copied texture in the window.
 		SDL_SetRenderTarget(m_renderer, NULL);
 		SDL_RenderCopy(m_renderer, m_screenBuf, NULL, NULL);
-		SDL_RenderPresent(m_renderer);
 	}
 }
 
+// Draw the camera image by uploading it to a streaming texture with a single lock,
+// leaving the renderer to flip the y-axis and scale it to fit the window
+void Application::renderStreaming(const Image& cameraBuf)
+{
+	// Recreate the texture only if the camera's image no longer fits in it;
+	// a smaller image just uses part of it, so lowering the resolution doesn't reallocate anything
+	int texWidth = 0, texHeight = 0;
+	if (m_cameraTexture != nullptr)
+		SDL_QueryTexture(m_cameraTexture, NULL, NULL, &texWidth, &texHeight);
+	if (m_cameraTexture == nullptr || texWidth < (int)cameraBuf.width() || texHeight < (int)cameraBuf.height())
+	{
+		if (m_cameraTexture != nullptr)
+			SDL_DestroyTexture(m_cameraTexture);
+
+		texWidth = max(texWidth, (int)cameraBuf.width());
+		texHeight = max(texHeight, (int)cameraBuf.height());
+		m_cameraTexture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, texWidth, texHeight);
+		if (m_cameraTexture == nullptr)
+		{
+			std::cout << "SDL_CreateTexture Error: " << SDL_GetError() << std::endl;
+			return;
+		}
+	}
+	const SDL_Rect imageRect = { 0, 0, (int)cameraBuf.width(), (int)cameraBuf.height() };
+
+	// Copy the image into the texture a row at a time, as the texture's rows may be padded
+	{
+		PROFILE_ZONE("Upload");
+		void* texPixels = nullptr;
+		int pitch = 0;
+		if (SDL_LockTexture(m_cameraTexture, &imageRect, &texPixels, &pitch) != 0)
+		{
+			std::cout << "SDL_LockTexture Error: " << SDL_GetError() << std::endl;
+			return;
+		}
+
+		const size_t rowSize = cameraBuf.width() * sizeof(Colour);
+		if (pitch == (int)rowSize)
+		{
+			memcpy(texPixels, cameraBuf.data(), rowSize * cameraBuf.height());
+		}
+		else
+		{
+			for (unsigned j = 0; j < cameraBuf.height(); ++j)
+				memcpy((Uint8*)texPixels + j * pitch, cameraBuf.data() + j * cameraBuf.width(), rowSize);
+		}
+		SDL_UnlockTexture(m_cameraTexture);
+	}
+
+	// Row 0 of the image is the bottom of the view plane, so flip it vertically when drawing
+	SDL_RenderCopyEx(m_renderer, m_cameraTexture, &imageRect, NULL, 0.0, NULL, SDL_FLIP_VERTICAL);
+}
+
+// Draw the timings and ray counters of the frame being shown over the top-left corner of the window
+void Application::drawStatsOverlay()
+{
+	if (!m_showStats)
+		return;
+
+	PROFILE_ZONE("Stats overlay");
+	const RenderedFrame& frame = m_frames.getReadBuffer();
+	const RayCounters& counters = frame.timings.rayCounters;
+	const unsigned numLines = 6;
+	char lines[numLines][128];
+	snprintf(lines[0], sizeof(lines[0]), "Frame %.2f ms (trace %.2f, shade %.2f)", frame.updateMs, frame.timings.traceMs, frame.timings.shadeMs);
+	snprintf(lines[1], sizeof(lines[1]), "Resolution %ux%u, sample stride %u%s", frame.image.width(), frame.image.height(),
+			 frame.timings.sampleStride, frame.dynamicResolution ? " (dynamic)" : "");
+	snprintf(lines[2], sizeof(lines[2]), "Primary rays %llu: %llu hits, %llu misses", counters.primaryRays, counters.hits, counters.misses);
+	snprintf(lines[3], sizeof(lines[3]), "Tests: %llu sphere, %llu plane, %llu box", counters.sphereTests, counters.planeTests, counters.boxTests);
+	snprintf(lines[4], sizeof(lines[4]), "Tests per ray %.2f (%s)", counters.getTestsPerRay(), frame.useSceneStore ? "scene store" : "objects");
+	snprintf(lines[5], sizeof(lines[5]), "Present (%s) %.2f ms, latency %.2f ms", m_presentPacer.getModeName(),
+			 m_presentPacer.getAveragePresentMs(), m_presentPacer.getAverageLatencyMs());
+
+	// Darken the area behind the text so that it can be read over any image (the font is 8x8 pixels)
+	const int lineHeight = 10, margin = 4;
+	size_t longestLine = 0;
+	for (unsigned lineIdx = 0; lineIdx < numLines; ++lineIdx)
+		longestLine = max(longestLine, strlen(lines[lineIdx]));
+	const SDL_Rect background = { 0, 0, 8 * (int)longestLine + 2 * margin, numLines * lineHeight + 2 * margin };
+	SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 160);
+	SDL_RenderFillRect(m_renderer, &background);
+
+	SDL_SetRenderDrawColor(m_renderer, 255, 255, 255, 255);
+	for (unsigned lineIdx = 0; lineIdx < numLines; ++lineIdx)
+		SDLTest_DrawString(m_renderer, margin, margin + lineIdx * lineHeight, lines[lineIdx]);
+}
+
+// Parses a whole command line value as a positive, finite number.
+// Returns false (leaving number unchanged) if it is anything else.
+static bool parsePositive(const char* value, double& number)
+{
+	char* end = nullptr;
+	const double parsed = strtod(value, &end);
+	if (end == value || *end != '\0' || !std::isfinite(parsed) || parsed <= 0.0)
+		return false;
+	number = parsed;
+	return true;
+}
+
+// Parses the value of the --present option: "vsync", "uncapped" or a number of frames per second.
+// Returns false (leaving the mode and rate unchanged) if it is none of these, or the rate isn't a positive finite number.
+static bool parsePresentMode(const char* value, PresentPacer::Mode& mode, double& rate)
+{
+	if (strcmp(value, "vsync") == 0)
+		mode = PresentPacer::Mode::VSync;
+	else if (strcmp(value, "uncapped") == 0)
+		mode = PresentPacer::Mode::Uncapped;
+	else
+	{
+		if (!parsePositive(value, rate))
+			return false;
+		mode = PresentPacer::Mode::FixedRate;
+	}
+	return true;
+}
+
+// Parses the value of the --target-ms option: a frame time in milliseconds, or "off" (giving zero) to always render at
+// the full resolution. Returns false (leaving targetMs unchanged) if it is neither, or the time isn't a positive finite number.
+static bool parseTargetFrameMs(const char* value, double& targetMs)
+{
+	if (strcmp(value, "off") != 0)
+		return parsePositive(value, targetMs);
+	targetMs = 0.0;
+	return true;
+}
+
 // Application entry point
-int main(int, char**)
+// Usage: comp270-worksheet-C [scene file] [--render-to image.ppm|image.png] [--frames N] [--resolution WxH] [--target-ms N|off] [--present vsync|uncapped|N] [--stats stats.json] [--trace trace.json]
+// With --render-to, N frames (1 by default) are rendered and written to disk without opening a window.
+// Otherwise the resolution is lowered as needed to render each frame in the target time (16.6 ms by default; off to always use
+// the full resolution). A target that isn't off or a positive number prints the usage.
+// --present chooses how frames are paced: waiting for vsync (the default), presenting each frame as soon as it is drawn,
+// or presenting at most N frames per second (any other value, or an N that isn't a positive number, prints the usage).
+// --stats writes the ray counters (totals over every frame, and those of the last frame traced) to a JSON file on exit.
+// --trace writes the zones recorded by the profiler to a Chrome trace file on exit (the build must define ENABLE_PROFILER).
+int main(int argc, char** argv)
 {
-	Application application;
-	if (application.run())
+	const char* scenePath = nullptr;
+	const char* imagePath = nullptr;
+	unsigned frames = 1;
+	unsigned resolutionX = 0, resolutionY = 0;	// Zero for the camera's default
+	double targetFrameMs = 16.6;
+	PresentPacer::Mode presentMode = PresentPacer::Mode::VSync;
+	double presentRate = 60.0;
+	const char* statsPath = nullptr;
+	const char* tracePath = nullptr;
+	for (int argIdx = 1; argIdx < argc; ++argIdx)
+	{
+		if (strcmp(argv[argIdx], "--render-to") == 0 && argIdx + 1 < argc)
+			imagePath = argv[++argIdx];
+		else if (strcmp(argv[argIdx], "--frames") == 0 && argIdx + 1 < argc)
+			frames = (unsigned)max(1, atoi(argv[++argIdx]));
+		else if (strcmp(argv[argIdx], "--stats") == 0 && argIdx + 1 < argc)
+			statsPath = argv[++argIdx];
+		else if (strcmp(argv[argIdx], "--trace") == 0 && argIdx + 1 < argc)
+			tracePath = argv[++argIdx];
+		else if (strcmp(argv[argIdx], "--target-ms") == 0 && argIdx + 1 < argc && parseTargetFrameMs(argv[argIdx + 1], targetFrameMs))
+			++argIdx;
+		else if (strcmp(argv[argIdx], "--present") == 0 && argIdx + 1 < argc && parsePresentMode(argv[argIdx + 1], presentMode, presentRate))
+			++argIdx;
+		else if (strcmp(argv[argIdx], "--resolution") == 0 && argIdx + 1 < argc && sscanf(argv[argIdx + 1], "%ux%u", &resolutionX, &resolutionY) == 2)
+			++argIdx;
+		else if (argv[argIdx][0] != '-' && scenePath == nullptr)
+			scenePath = argv[argIdx];
+		else
+		{
+			std::cout << "Usage: comp270-worksheet-C [scene file] [--render-to image.ppm|image.png] [--frames N] [--resolution WxH] [--target-ms N|off] [--present vsync|uncapped|N] [--stats stats.json] [--trace trace.json]" << std::endl;
+			return 1;
+		}
+	}
+
+	Application application(scenePath);
+	if (resolutionX > 0 && resolutionY > 0)
+		application.setRenderResolution(resolutionX, resolutionY);
+	if (imagePath == nullptr && targetFrameMs > 0.0)
+		application.setDynamicResolution(true, targetFrameMs);
+	application.setPresentMode(presentMode, presentRate);
+	if (statsPath != nullptr)
+		application.setStatsPath(statsPath);
+	if (tracePath != nullptr)
+		application.setTracePath(tracePath);
+	bool success = imagePath != nullptr ? application.renderToFile(imagePath, frames) : application.run();
+	if (success)
 		return 0;
 	else
 		return 1;
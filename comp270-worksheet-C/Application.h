@@ -1,33 +1,131 @@
 #pragma once
 #include "Camera.h"
+#include "SceneFile.h"
+#include "ResolutionController.h"
+#include "PresentPacer.h"
+#include "TripleBuffer.h"
 
 class Object;
 
 class Application
 {
 public:
-	Application();
+	Application(const char* scenePath = nullptr);
 	~Application();
 
 	bool run();
+	bool renderToFile(const char* imagePath, unsigned frames);
+
+	// Set the resolution of the rendered image (it is scaled to fit the window).
+	// With dynamic resolution this is the highest resolution, which is lowered as needed to meet the target frame time.
+	void setRenderResolution(unsigned resolutionX, unsigned resolutionY);
+	void setDynamicResolution(bool enabled, double targetFrameMs);
+
+	// Set how presents are paced (see PresentPacer.h); this must be done before run
+	void setPresentMode(PresentPacer::Mode mode, double targetRate) { m_presentPacer.setMode(mode, targetRate); }
+
+	// Set the file to write the profiler's recorded zones to when the application finishes (see Profiler.h)
+	void setTracePath(const char* path) { m_tracePath = path; }
+
+	// Set the file to write the ray counters (see RayStats.h) to as JSON when the application finishes
+	void setStatsPath(const char* path) { m_statsPath = path; }
 
 private:
+	// The camera settings chosen by the user. The main thread changes these in response to input and sends a copy
+	// to the render thread whenever they change; the render thread only applies the settings that differ from the last copy.
+	struct CameraState
+	{
+		Point3D		position;
+		Quaternion	orientation;
+		float		viewPlaneDistance = 5.0f;
+		unsigned	resolutionX = 0, resolutionY = 0;	// Highest resolution (dynamic resolution may render at less)
+		bool		dynamicResolution = false;
+		double		targetFrameMs = 16.6;
+		bool		progressive = true;
+		bool		useSceneStore = false;				// If true, trace the type-segregated copy of the objects rather than the objects themselves (set when a scene file is loaded)
+	};
+
+	// A finished image, handed from the render thread to the main thread along with the statistics shown by the overlay
+	struct RenderedFrame
+	{
+		Image					image;
+		Camera::FrameTimings	timings;
+		double					updateMs = 0.0;			// Total time taken by the camera to update the image
+		bool					dynamicResolution = false;
+		bool					useSceneStore = false;
+		std::chrono::steady_clock::time_point	finishedTime;	// When the render thread published the frame
+	};
+
 	bool initSDL();
 	void shutdownSDL();
 
+	bool writeTrace();
+	bool writeStats();
+	void drawStatsOverlay();
 	void processEvent(const SDL_Event &e);
-	void setupScene();
-	void render();
+	bool setupScene();
+	const Image& updateCameraImage();
+
+	// Render thread
+	void startRenderThread();
+	void stopRenderThread();
+	void sendCameraState();
+	void renderLoop();
+	bool renderFrame();
+	void applyCameraState(const CameraState& state);
+
+	// Presentation (main thread)
+	bool drawLatestFrame();
+	void presentFrame(bool newFrame);
+	void renderPerPixel(const Image& cameraBuf);
+	void renderStreaming(const Image& cameraBuf);
+
+	void scaleResolution(float scale);
 
 	const int c_windowWidth = 800;
 	const int c_windowHeight = 700;
+	const unsigned c_minResolution = 16;	// Smallest image width or height the resolution can be scaled down to
 
 	SDL_Window* m_window = nullptr;
 	SDL_Renderer* m_renderer = nullptr;
 	SDL_Texture* m_screenBuf = nullptr;
+	SDL_Texture* m_cameraTexture = nullptr;	// Streaming texture at least as large as the camera's image (only the top-left part is used)
+
+	bool m_useStreamingUpload = true;	// If true, upload the camera image in one go rather than drawing each pixel
 
 	bool m_quit = false;
+	bool m_redrawWindow = true;		// If true, the window is drawn again even if there isn't a new frame
+	bool m_showStats = true;		// If true, the stats overlay is drawn over the image
+	PresentPacer m_presentPacer;	// Decides when to present frames, and measures how long presenting takes
 
-	std::vector<Object*> m_objects;
+	// Camera settings, owned by the main thread and sent to the render thread
+	CameraState m_cameraState;
+	bool m_cameraStateChanged = false;		// Set when m_cameraState has changed since it was last sent
+
+	// Communication between the threads. Neither thread waits for the other to hand over a camera state or a frame;
+	// the mutex and condition variable are only used to put the render thread to sleep when it has nothing to do.
+	std::thread m_renderThread;
+	TripleBuffer<CameraState> m_cameraStates;	// Mailbox holding the latest camera state sent by the main thread
+	TripleBuffer<RenderedFrame> m_frames;		// The latest frame finished by the render thread
+	std::mutex m_renderMutex;					// Guards m_stopRendering, and is held by the render thread while checking for work
+	std::condition_variable m_wakeRenderThread;	// Signalled when a camera state is sent or the render thread should stop
+	bool m_stopRendering = false;
+	Uint32 m_frameReadyEvent = 0;				// SDL user event pushed by the render thread to wake the main thread for a new frame
+	std::atomic<bool> m_frameEventPending{ false };	// Set while a frame ready event is waiting in the queue (so only one is queued at a time)
+
+	// Owned by the render thread while it is running
 	Camera m_camera;
-};
+	ResolutionController m_resolutionController;	// Adjusts the camera's resolution to keep frame times near a target (when enabled)
+	CameraState m_appliedState;					// The camera state last applied to m_camera
+	bool m_cameraStateApplied = false;			// Set once a camera state has been applied
+	Camera::FrameTimings m_statsTimings;		// Timings of the last frame that traced anything
+	unsigned m_framesTraced = 0;				// Number of frames that traced anything
+
+	std::vector<Object*> m_objects;			// For a loaded scene file, only created if the objects are traced rather than the file's store
+	Scene m_scene;
+	SceneFile m_sceneFile;
+	std::string m_tracePath;				// File to write the profiler trace to (empty to not write one)
+	std::string m_statsPath;				// File to write the ray counters to (empty to not write them)
+	std::string m_scenePath;				// File to load the scene from (empty for the built-in scene)
+	const Scene* m_sceneStore = &m_scene;	// The scene store to trace (either m_scene or the loaded file's)
+};
\ No newline at end of file
@@ -0,0 +1,397 @@
+#include "stdafx.h"
+#include "BVH.h"
+#include "Object.h"
+#include "RayStats.h"
+
+// Returns the component of a point along the given axis (0 = x, 1 = y, 2 = z)
+static float getComponent(const Point3D& pt, unsigned axis)
+{
+	return axis == 0 ? pt.x : (axis == 1 ? pt.y : pt.z);
+}
+
+// Returns the index of the bin that the given centre falls into when binning along an axis
+static unsigned getBinIndex(float centre, float binsMin, float binsScale, unsigned numBins)
+{
+	int bin = (int)((centre - binsMin) * binsScale);
+	return (unsigned)max(0, min((int)numBins - 1, bin));
+}
+
+// Tests a node's box against every ray in the packet, ignoring rays that have already hit something closer than the box.
+// Returns true if any ray enters the box, and gives the nearest distance at which one does.
+// The loop covers the whole (padded) packet and has no data-dependent branches, so the compiler can vectorise it.
+static bool getPacketBoxIntersection(const AABB& bounds, const RayPacket& packet, const RayPacket& invRayDirs, const PacketHits& hits, float& entryDist)
+{
+	const float minX = bounds.minCorner.x - packet.origin.x, maxX = bounds.maxCorner.x - packet.origin.x;
+	const float minY = bounds.minCorner.y - packet.origin.y, maxY = bounds.maxCorner.y - packet.origin.y;
+	const float minZ = bounds.minCorner.z - packet.origin.z, maxZ = bounds.maxCorner.z - packet.origin.z;
+
+	// The same calculation as AABB::getIntersection, for each ray (but using plain comparisons rather than fminf and fmaxf,
+	// which the compiler may not inline or vectorise)
+	float nearest = FLT_MAX;
+	for (unsigned rayIdx = 0; rayIdx < RayPacket::c_maxSize; ++rayIdx)
+	{
+		const float tx1 = minX * invRayDirs.dirX[rayIdx], tx2 = maxX * invRayDirs.dirX[rayIdx];
+		const float ty1 = minY * invRayDirs.dirY[rayIdx], ty2 = maxY * invRayDirs.dirY[rayIdx];
+		const float tz1 = minZ * invRayDirs.dirZ[rayIdx], tz2 = maxZ * invRayDirs.dirZ[rayIdx];
+
+		const float tEnter = max(max(min(tx1, tx2), min(ty1, ty2)), min(tz1, tz2));
+		const float tExit = min(min(max(tx1, tx2), max(ty1, ty2)), max(tz1, tz2));
+
+		const bool hit = (rayIdx < packet.count) & (tEnter <= tExit) & (tExit >= 0.0f) & (tEnter < hits.distance[rayIdx]);
+		nearest = min(nearest, hit ? tEnter : FLT_MAX);
+	}
+
+	entryDist = nearest;
+	return nearest < FLT_MAX;
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Builds the tree over the given objects, splitting nodes where the surface area heuristic says it is worthwhile
+void BVH::build(const std::vector<Object*>& objects)
+{
+	m_nodes.clear();
+	m_objects.clear();
+	m_unbounded.clear();
+	m_sourceObjects = objects;
+
+	std::vector<BuildItem> items;
+	items.reserve(objects.size());
+	for (auto obj : objects)
+	{
+		BuildItem item;
+		item.object = obj;
+		if (obj->getBounds(item.bounds))
+		{
+			item.centre = item.bounds.centre();
+			items.push_back(item);
+		}
+		else
+		{
+			m_unbounded.push_back(obj);
+		}
+	}
+
+	if (!items.empty())
+	{
+		m_objects.reserve(items.size());
+		m_nodes.reserve(2 * items.size());
+		m_nodes.push_back(Node());
+		buildNode(0, items, 0, (unsigned)items.size(), 0);
+	}
+}
+
+// Recomputes the bounds of every node after objects have moved, keeping the tree's structure.
+// This is much cheaper than a rebuild, but the tree becomes less efficient the further the objects move.
+void BVH::refit()
+{
+	// Children are always stored after their parents, so updating in reverse order visits them first
+	for (unsigned nodeIdx = (unsigned)m_nodes.size(); nodeIdx-- > 0; )
+	{
+		Node& node = m_nodes[nodeIdx];
+		node.bounds = AABB();
+		if (node.isLeaf())
+		{
+			for (unsigned objIdx = node.firstIdx; objIdx < node.firstIdx + node.count; ++objIdx)
+			{
+				AABB objBounds;
+				if (m_objects[objIdx]->getBounds(objBounds))
+					node.bounds.expand(objBounds);
+			}
+		}
+		else
+		{
+			node.bounds.expand(m_nodes[node.firstIdx].bounds);
+			node.bounds.expand(m_nodes[node.firstIdx + 1].bounds);
+		}
+	}
+}
+
+// Returns a pointer to the closest object to the ray source that is intersected by the ray.
+// Params:
+//	raySrc		starting point of the ray (input)
+//	rayDir		direction of the ray (input)
+//	counters	the calling thread's ray counters, which the tests are added to (input/output)
+const Object* BVH::getClosestIntersectedObject(const Point3D& raySrc, const Vector3D& rayDir, RayCounters& counters) const
+{
+	float distToNearestObject = FLT_MAX;
+	const Object* nearestObject = nullptr;
+
+	for (auto obj : m_unbounded)
+	{
+		float distToFirstIntersection = FLT_MAX;
+		if (obj->getIntersection(raySrc, rayDir, distToFirstIntersection, counters)
+			&& distToFirstIntersection < distToNearestObject)
+		{
+			nearestObject = obj;
+			distToNearestObject = distToFirstIntersection;
+		}
+	}
+
+	if (m_nodes.empty())
+		return nearestObject;
+
+	// Visit nodes the ray passes through, nearest first, skipping any that start beyond the closest hit so far
+	const Vector3D invRayDir(1.0f / rayDir.x, 1.0f / rayDir.y, 1.0f / rayDir.z);
+	struct StackEntry { unsigned nodeIdx; float entryDist; };
+	StackEntry stack[c_maxDepth + 1];
+	unsigned stackSize = 0;
+	unsigned boxTests = 1;
+
+	float entryDist;
+	if (m_nodes[0].bounds.getIntersection(raySrc, invRayDir, distToNearestObject, entryDist))
+		stack[stackSize++] = { 0, entryDist };
+
+	while (stackSize > 0)
+	{
+		const StackEntry entry = stack[--stackSize];
+		if (entry.entryDist >= distToNearestObject)
+			continue;
+
+		const Node& node = m_nodes[entry.nodeIdx];
+		if (node.isLeaf())
+		{
+			for (unsigned objIdx = node.firstIdx; objIdx < node.firstIdx + node.count; ++objIdx)
+			{
+				float distToFirstIntersection = FLT_MAX;
+				if (m_objects[objIdx]->getIntersection(raySrc, rayDir, distToFirstIntersection, counters)
+					&& distToFirstIntersection < distToNearestObject)
+				{
+					nearestObject = m_objects[objIdx];
+					distToNearestObject = distToFirstIntersection;
+				}
+			}
+		}
+		else
+		{
+			float leftDist, rightDist;
+			boxTests += 2;
+			bool hitLeft = m_nodes[node.firstIdx].bounds.getIntersection(raySrc, invRayDir, distToNearestObject, leftDist);
+			bool hitRight = m_nodes[node.firstIdx + 1].bounds.getIntersection(raySrc, invRayDir, distToNearestObject, rightDist);
+
+			// Push the further child first, so the nearer one is visited next
+			if (hitLeft && hitRight)
+			{
+				if (leftDist < rightDist)
+				{
+					stack[stackSize++] = { node.firstIdx + 1, rightDist };
+					stack[stackSize++] = { node.firstIdx, leftDist };
+				}
+				else
+				{
+					stack[stackSize++] = { node.firstIdx, leftDist };
+					stack[stackSize++] = { node.firstIdx + 1, rightDist };
+				}
+			}
+			else if (hitLeft)
+			{
+				stack[stackSize++] = { node.firstIdx, leftDist };
+			}
+			else if (hitRight)
+			{
+				stack[stackSize++] = { node.firstIdx + 1, rightDist };
+			}
+		}
+	}
+
+	counters.boxTests += boxTests;
+	return nearestObject;
+}
+
+void BVH::getClosestPacketIntersections(const RayPacket& packet, PacketHits& hits, RayCounters& counters) const
+{
+	for (auto obj : m_unbounded)
+		obj->getPacketIntersections(packet, hits, counters);
+
+	if (m_nodes.empty())
+		return;
+
+	// Visit the nodes any ray passes through, nearest first. A node is skipped if every ray has already hit something
+	// closer than the nearest point at which any of them enters it.
+	RayPacket invRayDirs;
+	for (unsigned rayIdx = 0; rayIdx < RayPacket::c_maxSize; ++rayIdx)
+	{
+		invRayDirs.dirX[rayIdx] = 1.0f / packet.dirX[rayIdx];
+		invRayDirs.dirY[rayIdx] = 1.0f / packet.dirY[rayIdx];
+		invRayDirs.dirZ[rayIdx] = 1.0f / packet.dirZ[rayIdx];
+	}
+
+	struct StackEntry { unsigned nodeIdx; float entryDist; };
+	StackEntry stack[c_maxDepth + 1];
+	unsigned stackSize = 0;
+	unsigned boxTests = packet.count;
+
+	float entryDist;
+	if (getPacketBoxIntersection(m_nodes[0].bounds, packet, invRayDirs, hits, entryDist))
+		stack[stackSize++] = { 0, entryDist };
+
+	while (stackSize > 0)
+	{
+		const StackEntry entry = stack[--stackSize];
+		float furthestHit = 0.0f;
+		for (unsigned rayIdx = 0; rayIdx < packet.count; ++rayIdx)
+			furthestHit = max(furthestHit, hits.distance[rayIdx]);
+		if (entry.entryDist >= furthestHit)
+			continue;
+
+		const Node& node = m_nodes[entry.nodeIdx];
+		if (node.isLeaf())
+		{
+			for (unsigned objIdx = node.firstIdx; objIdx < node.firstIdx + node.count; ++objIdx)
+				m_objects[objIdx]->getPacketIntersections(packet, hits, counters);
+		}
+		else
+		{
+			float leftDist, rightDist;
+			boxTests += 2 * packet.count;
+			bool hitLeft = getPacketBoxIntersection(m_nodes[node.firstIdx].bounds, packet, invRayDirs, hits, leftDist);
+			bool hitRight = getPacketBoxIntersection(m_nodes[node.firstIdx + 1].bounds, packet, invRayDirs, hits, rightDist);
+
+			// Push the further child first, so the nearer one is visited next
+			if (hitLeft && hitRight)
+			{
+				if (leftDist < rightDist)
+				{
+					stack[stackSize++] = { node.firstIdx + 1, rightDist };
+					stack[stackSize++] = { node.firstIdx, leftDist };
+				}
+				else
+				{
+					stack[stackSize++] = { node.firstIdx, leftDist };
+					stack[stackSize++] = { node.firstIdx + 1, rightDist };
+				}
+			}
+			else if (hitLeft)
+			{
+				stack[stackSize++] = { node.firstIdx, leftDist };
+			}
+			else if (hitRight)
+			{
+				stack[stackSize++] = { node.firstIdx + 1, rightDist };
+			}
+		}
+	}
+
+	counters.boxTests += boxTests;
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Fills in the node for the given range of items, splitting it into two children if worthwhile
+void BVH::buildNode(unsigned nodeIdx, std::vector<BuildItem>& items, unsigned first, unsigned count, unsigned depth)
+{
+	AABB bounds, centreBounds;
+	for (unsigned itemIdx = first; itemIdx < first + count; ++itemIdx)
+	{
+		bounds.expand(items[itemIdx].bounds);
+		centreBounds.expand(items[itemIdx].centre);
+	}
+	m_nodes[nodeIdx].bounds = bounds;
+
+	unsigned splitAxis = 0, splitBin = 0;
+	unsigned mid = first;
+	if (count > 1 && depth < c_maxDepth && findBestSplit(items, first, count, bounds, centreBounds, splitAxis, splitBin))
+	{
+		const float binsMin = getComponent(centreBounds.minCorner, splitAxis);
+		const float binsScale = c_numBins / (getComponent(centreBounds.maxCorner, splitAxis) - binsMin);
+		mid = (unsigned)(std::partition(items.begin() + first, items.begin() + first + count, [&](const BuildItem& item)
+		{
+			return getBinIndex(getComponent(item.centre, splitAxis), binsMin, binsScale, c_numBins) <= splitBin;
+		}) - items.begin());
+	}
+
+	if (mid == first || mid == first + count)
+	{
+		// No useful split, so make a leaf (unless it would be too big, in which case just halve it)
+		if (count <= c_maxLeafSize || depth >= c_maxDepth)
+		{
+			m_nodes[nodeIdx].firstIdx = (unsigned)m_objects.size();
+			m_nodes[nodeIdx].count = count;
+			for (unsigned itemIdx = first; itemIdx < first + count; ++itemIdx)
+				m_objects.push_back(items[itemIdx].object);
+			return;
+		}
+		mid = first + count / 2;
+	}
+
+	const unsigned leftIdx = (unsigned)m_nodes.size();
+	m_nodes[nodeIdx].firstIdx = leftIdx;
+	m_nodes[nodeIdx].count = 0;
+	m_nodes.push_back(Node());
+	m_nodes.push_back(Node());
+
+	buildNode(leftIdx, items, first, mid - first, depth + 1);
+	buildNode(leftIdx + 1, items, mid, first + count - mid, depth + 1);
+}
+
+// Uses the surface area heuristic to find the best split of a range of items into two groups.
+// Items are binned by their centres along each axis, and every boundary between bins is considered as a split.
+// Returns true if a split was found that is expected to be cheaper to trace than making a leaf.
+// Params:
+//	items, first, count		the items to split (input)
+//	bounds					bounds of the items (input)
+//	centreBounds			bounds of the items' centres (input)
+//	splitAxis				the axis to split along (output)
+//	splitBin				items in this bin or lower go in the left group (output)
+bool BVH::findBestSplit(const std::vector<BuildItem>& items, unsigned first, unsigned count, const AABB& bounds,
+						const AABB& centreBounds, unsigned& splitAxis, unsigned& splitBin) const
+{
+	// Costs are relative to the cost of one intersection test
+	const float traversalCost = 1.0f;
+	float bestCost = (count <= c_maxLeafSize) ? (float)count : FLT_MAX;
+	bool foundSplit = false;
+
+	const float invParentArea = 1.0f / max(bounds.surfaceArea(), FLT_MIN);
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		const float binsMin = getComponent(centreBounds.minCorner, axis);
+		const float extent = getComponent(centreBounds.maxCorner, axis) - binsMin;
+		if (extent <= 0.0f)
+			continue;
+
+		AABB binBounds[c_numBins];
+		unsigned binCounts[c_numBins] = {};
+		const float binsScale = c_numBins / extent;
+		for (unsigned itemIdx = first; itemIdx < first + count; ++itemIdx)
+		{
+			unsigned bin = getBinIndex(getComponent(items[itemIdx].centre, axis), binsMin, binsScale, c_numBins);
+			binBounds[bin].expand(items[itemIdx].bounds);
+			++binCounts[bin];
+		}
+
+		// Sweep from the right to get the area and count of everything above each boundary...
+		float rightAreas[c_numBins];
+		unsigned rightCounts[c_numBins];
+		AABB rightBounds;
+		unsigned rightCount = 0;
+		for (unsigned bin = c_numBins - 1; bin > 0; --bin)
+		{
+			rightBounds.expand(binBounds[bin]);
+			rightCount += binCounts[bin];
+			rightAreas[bin] = rightBounds.surfaceArea();
+			rightCounts[bin] = rightCount;
+		}
+
+		// ...then sweep from the left, evaluating the cost of splitting at each boundary
+		AABB leftBounds;
+		unsigned leftCount = 0;
+		for (unsigned bin = 0; bin < c_numBins - 1; ++bin)
+		{
+			leftBounds.expand(binBounds[bin]);
+			leftCount += binCounts[bin];
+			if (leftCount == 0 || rightCounts[bin + 1] == 0)
+				continue;
+
+			float cost = traversalCost + (leftBounds.surfaceArea() * leftCount + rightAreas[bin + 1] * rightCounts[bin + 1]) * invParentArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				splitAxis = axis;
+				splitBin = bin;
+				foundSplit = true;
+			}
+		}
+	}
+
+	return foundSplit;
+}
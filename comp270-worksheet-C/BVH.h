@@ -0,0 +1,57 @@
+#pragma once
+#include "AABB.h"
+#include "RayPacket.h"
+
+class Object;
+struct RayCounters;
+
+// A bounding volume hierarchy over a list of objects, for finding the closest object hit by a ray
+// without testing every object in the scene.
+// Objects without finite bounds (e.g. infinite planes) are kept in a separate list and always tested.
+class BVH
+{
+public:
+	void	build(const std::vector<Object*>& objects);
+	void	refit();
+
+	// Returns true if the hierarchy was built over exactly this list of objects
+	bool	isBuiltFor(const std::vector<Object*>& objects) const { return objects == m_sourceObjects; }
+
+	const Object*	getClosestIntersectedObject(const Point3D& raySrc, const Vector3D& rayDir, RayCounters& counters) const;
+
+	// Finds the closest object hit by each ray in the packet, traversing the hierarchy once for the whole packet and
+	// intersecting each leaf's objects with every ray at once (so spheres use the SIMD packet kernels)
+	void	getClosestPacketIntersections(const RayPacket& packet, PacketHits& hits, RayCounters& counters) const;
+
+private:
+	// A node in the tree; leaves refer to a range of m_objects, interior nodes to a pair of adjacent child nodes
+	struct Node
+	{
+		AABB		bounds;				// Bounds of all the objects beneath this node
+		unsigned	firstIdx = 0;		// Index of the first object (for a leaf) or the left child node (for an interior node)
+		unsigned	count = 0;			// Number of objects (for a leaf), or zero for an interior node
+
+		bool	isLeaf() const { return count > 0; }
+	};
+
+	// An object's bounds and centre, used while building the tree
+	struct BuildItem
+	{
+		const Object*	object;
+		AABB			bounds;
+		Point3D			centre;
+	};
+
+	void	buildNode(unsigned nodeIdx, std::vector<BuildItem>& items, unsigned first, unsigned count, unsigned depth);
+	bool	findBestSplit(const std::vector<BuildItem>& items, unsigned first, unsigned count, const AABB& bounds,
+						  const AABB& centreBounds, unsigned& splitAxis, unsigned& splitBin) const;
+
+	static const unsigned	c_maxLeafSize = 4;		// Nodes with more objects than this are always split (if possible)
+	static const unsigned	c_numBins = 16;			// Number of candidate split positions per axis when building
+	static const unsigned	c_maxDepth = 64;		// Maximum depth of the tree (limits the traversal stack)
+
+	std::vector<Node>			m_nodes;			// The tree's nodes, with the root first
+	std::vector<const Object*>	m_objects;			// Bounded objects, ordered so that each leaf refers to a contiguous range
+	std::vector<const Object*>	m_unbounded;		// Objects with no finite bounds
+	std::vector<Object*>		m_sourceObjects;	// The list of objects the tree was built over
+};
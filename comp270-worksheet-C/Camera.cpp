@@ -1,58 +1,186 @@
 #include "stdafx.h"
 #include "Camera.h"
 #include "Object.h"
+#include "MatrixKinds.h"
+#include "Profiler.h"
+
+// Returns the number of milliseconds elapsed since the given time
+static double getMsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Distance between the pixels traced in each progressive refinement pass
+static const unsigned c_refinementStrides[] = { 4, 2, 1 };
 
 // Initialises the camera at the given position
 void Camera::init(const Point3D& pos)
 {
 	m_position = pos;
+	setRenderThreadCount(std::thread::hardware_concurrency());
 	m_screenBuf.init(m_viewPlane.resolutionX, m_viewPlane.resolutionY);
 }
 
+// Changes the resolution of the image. The rays are generated again before the next frame, which starts
+// progressive refinement again; the image and the cached rays and hits are resized in place.
+// Params:
+//	resolutionX, resolutionY	The number of pixels in the x and y directions (at least 1)
+void Camera::setResolution(unsigned resolutionX, unsigned resolutionY)
+{
+	resolutionX = max(1u, resolutionX);
+	resolutionY = max(1u, resolutionY);
+	if (resolutionX == m_viewPlane.resolutionX && resolutionY == m_viewPlane.resolutionY)
+		return;
+
+	m_viewPlane.resolutionX = resolutionX;
+	m_viewPlane.resolutionY = resolutionY;
+	m_zoomChanged = true;
+
+	// The image is only created by init, so that nothing is traced before then
+	if (m_screenBuf.isInitialised())
+		m_screenBuf.init(resolutionX, resolutionY);
+}
+
+// Sets the camera's world space orientation. The world rays are generated again before the next frame.
+void Camera::setOrientation(const Quaternion& orientation)
+{
+	m_orientation = orientation;
+	m_orientationChanged = true;
+	m_basisValid = false;
+	m_worldTransformChanged = true;
+}
+
+// Rotates the camera about one of its own axes.
+// Params:
+//	localAxis	Unit axis in camera space (before the camera's rotation is applied)
+//	angle		Angle to rotate by, in radians
+void Camera::rotate(const Vector3D& localAxis, float angle)
+{
+	Quaternion orientation = m_orientation;
+	orientation.rotate(localAxis, angle);
+	setOrientation(orientation);
+}
+
+// Rebuilds the world space directions of the camera's axes from its orientation, if it has changed since they were last built
+void Camera::updateBasis() const
+{
+	if (m_basisValid)
+		return;
+
+	// The camera looks along its negative z-axis
+	Vector3D backward;
+	m_orientation.getAxes(m_right, m_up, backward);
+	m_forward = backward * -1.0f;
+	m_basisValid = true;
+}
+
 // Cast rays through the view plane and set colours based on what they intersect with
 const Image& Camera::updateScreenBuffer(const std::vector<Object*>& objects)
 {
-	if (m_screenBuf.isInitialised())
+	// If nothing has changed since the last complete image, there's no need to trace it again
+	if (haveObjectsChanged(objects))
+		m_objectsMoved = true;
+	if (isImageUpToDate(&objects))
+		return reuseImage();
+
+	auto phaseStart = std::chrono::steady_clock::now();
+	if (!beginFrame(&objects))
+		return m_screenBuf;
+
 	{
-		m_screenBuf.clear();
+		PROFILE_ZONE("Transform");
 
-		// Make sure our cached values are up to date
-		if (m_zoomChanged)
+		// Transform the objects to the camera's coordinate system
+		// (unless the rays are being transformed to world space instead)
+		if (!m_transformRays)
 		{
-			generateRays();
-			m_zoomChanged = false;
+			for (auto obj : objects)
+				obj->applyTransformation(m_worldToCameraTransform);
 		}
-		if (m_worldTransformChanged)
+
+		// Make sure the hierarchy matches the objects (which move every frame if they are transformed to camera space)
+		if (m_useBVH)
 		{
-			updateWorldTransform();
-			m_worldTransformChanged = false;
+			if (!m_bvh.isBuiltFor(objects))
+				m_bvh.build(objects);
+			else if (m_objectsMoved || !m_transformRays)
+				m_bvh.refit();
 		}
+	}
+	m_frameTimings.transformMs = getMsSince(phaseStart);
 
-		if (!m_pixelRays.empty())
-		{
-			// Transform the objects to the camera's coordinate system
-			for (auto obj : objects)
-				obj->applyTransformation(m_worldToCameraTransform);
+	// Find the closest object to each pixel, then set the colours based on them,
+	// processing tiles of the view plane in parallel
+	// (only the samples needed for this refinement pass are traced; hits from earlier passes are kept)
+	phaseStart = std::chrono::steady_clock::now();
+	m_pixelHits.resize(m_viewPlane.resolutionX * m_viewPlane.resolutionY);
+	const unsigned tilesX = (m_viewPlane.resolutionX + m_tileSize - 1) / m_tileSize;
+	const unsigned tilesY = (m_viewPlane.resolutionY + m_tileSize - 1) / m_tileSize;
+	std::atomic<unsigned> raysCast(0);
+	{
+		PROFILE_ZONE("Trace");
+		m_threadPool.parallelFor(tilesX * tilesY, [&](unsigned tileIdx) { raysCast += traceTile(tileIdx, tilesX, objects); });
+	}
+	m_frameTimings.traceMs = getMsSince(phaseStart);
 
-			// Set the colour based on the closest object to each pixel
-			Point3D origin;
-			for (unsigned i = 0; i < m_viewPlane.resolutionX; ++i)
-			{
-				for (unsigned j = 0; j < m_viewPlane.resolutionY; ++j)
-				{
-					const Object* object = getClosestIntersectedObject(origin, m_pixelRays[i][j], objects);
-					if (object != nullptr)
-						setPixelColourFromObject(i, j, object);
-				}
-			}
+	phaseStart = std::chrono::steady_clock::now();
+	{
+		PROFILE_ZONE("Shade");
+		m_threadPool.parallelFor(tilesX * tilesY, [&](unsigned tileIdx) { shadeTile(tileIdx, tilesX); });
+	}
+	m_frameTimings.shadeMs = getMsSince(phaseStart);
 
-			// Now put the objects back!
-			const Matrix3D cameraToWorldTransform = m_worldToCameraTransform.inverseTransform();
-			for (auto obj : objects)
-				obj->applyTransformation(cameraToWorldTransform);
-		}
+	// Now put the objects back!
+	phaseStart = std::chrono::steady_clock::now();
+	if (!m_transformRays)
+	{
+		PROFILE_ZONE("Transform back");
+		for (auto obj : objects)
+			obj->applyTransformation(m_cameraToWorldTransform);
 	}
-	
+	m_frameTimings.transformMs += getMsSince(phaseStart);
+	m_frameTimings.raysCast = raysCast;
+
+	recordObjectRevisions(objects);
+	endFrame();
+	return m_screenBuf;
+}
+
+// Cast rays through the view plane and set colours based on the primitives in the scene store they intersect with.
+// The scene is always in world space, so the rays are transformed to meet it.
+const Image& Camera::updateScreenBuffer(const Scene& scene)
+{
+	if (scene.getRevision() != m_sceneRevision)
+		m_objectsMoved = true;
+	if (isImageUpToDate(&scene))
+		return reuseImage();
+
+	auto phaseStart = std::chrono::steady_clock::now();
+	if (!beginFrame(&scene))
+		return m_screenBuf;
+	m_frameTimings.transformMs = getMsSince(phaseStart);
+
+	phaseStart = std::chrono::steady_clock::now();
+	m_sceneHits.resize(m_viewPlane.resolutionX * m_viewPlane.resolutionY);
+	const unsigned tilesX = (m_viewPlane.resolutionX + m_tileSize - 1) / m_tileSize;
+	const unsigned tilesY = (m_viewPlane.resolutionY + m_tileSize - 1) / m_tileSize;
+	std::atomic<unsigned> raysCast(0);
+	{
+		PROFILE_ZONE("Trace");
+		m_threadPool.parallelFor(tilesX * tilesY, [&](unsigned tileIdx) { raysCast += traceSceneTile(tileIdx, tilesX, scene); });
+	}
+	m_frameTimings.traceMs = getMsSince(phaseStart);
+
+	phaseStart = std::chrono::steady_clock::now();
+	{
+		PROFILE_ZONE("Shade");
+		m_threadPool.parallelFor(tilesX * tilesY, [&](unsigned tileIdx) { shadeSceneTile(tileIdx, tilesX, scene); });
+	}
+	m_frameTimings.shadeMs = getMsSince(phaseStart);
+	m_frameTimings.raysCast = raysCast;
+
+	m_sceneRevision = scene.getRevision();
+	endFrame();
 	return m_screenBuf;
 }
 
@@ -61,56 +189,376 @@ const Image& Camera::updateScreenBuffer(const std::vector<Object*>& objects)
 // Generates and stores rays from the camera through the centre of each pixel, in camera space
 void Camera::generateRays()
 {
-	m_pixelRays.clear();
-	// TODO: store the ray direction (in camera space through each pixel of the subdivided view plane,
-	// and store it at an appropriate index of m_pixelRays
+	PROFILE_ZONE("Generate rays");
+
+	// The camera looks along the positive z-axis in camera space, with the view plane centred on it
+	generateRays(m_pixelRays, Vector3D(1.0f, 0.0f, 0.0f), Vector3D(0.0f, 1.0f, 0.0f), Vector3D(0.0f, 0.0f, 1.0f));
+}
+
+// Generates unit length rays from the camera through the centre of each pixel, directly in whichever space the view plane's
+// axes are given in. Each direction is the sum of the axes scaled by the pixel's position on the view plane, so no matrix is needed.
+// Params:
+//	rays	Buffer to store the directions in, resized to the resolution (output)
+//	xAxis	Direction of the view plane's x-axis (to the right of the image) (input)
+//	yAxis	Direction of the view plane's y-axis (to the top of the image) (input)
+//	zAxis	Direction from the camera to the centre of the view plane (input)
+void Camera::generateRays(RayBuffer& rays, const Vector3D& xAxis, const Vector3D& yAxis, const Vector3D& zAxis) const
+{
+	const unsigned resX = m_viewPlane.resolutionX, resY = m_viewPlane.resolutionY;
+	const float pixelWidth = 2.0f * m_viewPlane.halfWidth / resX;
+	const float pixelHeight = 2.0f * m_viewPlane.halfHeight / resY;
+
+	rays.resize(resX * resY);
+	float* dirX = rays.x();
+	float* dirY = rays.y();
+	float* dirZ = rays.z();
+	for (unsigned j = 0; j < resY; ++j)
+	{
+		// Every pixel in the row shares the same offset along the view direction and the y-axis
+		const float y = -m_viewPlane.halfHeight + (j + 0.5f) * pixelHeight;
+		const float rowX = zAxis.x * m_viewPlane.distance + yAxis.x * y;
+		const float rowY = zAxis.y * m_viewPlane.distance + yAxis.y * y;
+		const float rowZ = zAxis.z * m_viewPlane.distance + yAxis.z * y;
+		for (unsigned i = 0; i < resX; ++i)
+		{
+			const unsigned idx = i + resX * j;
+			const float x = -m_viewPlane.halfWidth + (i + 0.5f) * pixelWidth;
+			dirX[idx] = rowX + xAxis.x * x;
+			dirY[idx] = rowY + xAxis.y * x;
+			dirZ[idx] = rowZ + xAxis.z * x;
+		}
+	}
+
+	// Make the directions unit length, several at a time
+	VectorMath::normaliseArrays(dirX, dirY, dirZ, resX * resY);
+}
+
+// Returns true if the current image already shows the given objects or scene at full pixel density,
+// i.e. neither the camera, the view plane nor anything being traced has changed since it was rendered
+bool Camera::isImageUpToDate(const void* source) const
+{
+	return m_imageComplete && source == m_lastSource && m_screenBuf.isInitialised()
+		&& !m_worldTransformChanged && !m_zoomChanged && !m_objectsMoved;
+}
+
+// Returns the current image without tracing anything
+const Image& Camera::reuseImage()
+{
+	m_frameTimings = FrameTimings();
+	m_frameTimings.imageReused = true;
+	return m_screenBuf;
+}
+
+// Returns true if the list of objects, or any of the objects themselves, has changed since recordObjectRevisions was last called
+bool Camera::haveObjectsChanged(const std::vector<Object*>& objects) const
+{
+	if (objects.size() != m_objectRevisions.size())
+		return true;
+
+	for (unsigned objIdx = 0; objIdx < objects.size(); ++objIdx)
+	{
+		if (objects[objIdx] != m_objectRevisions[objIdx].object || objects[objIdx]->getRevision() != m_objectRevisions[objIdx].revision)
+			return true;
+	}
+	return false;
+}
+
+// Stores the current revision of each object, for haveObjectsChanged to compare against
+void Camera::recordObjectRevisions(const std::vector<Object*>& objects)
+{
+	m_objectRevisions.resize(objects.size());
+	for (unsigned objIdx = 0; objIdx < objects.size(); ++objIdx)
+		m_objectRevisions[objIdx] = { objects[objIdx], objects[objIdx]->getRevision() };
+}
+
+// Makes sure the cached rays and transforms are up to date, and chooses which pixels to trace this frame.
+// Returns false if there is nothing to trace.
+// Params:
+//	source	The objects or scene being traced; progressive refinement restarts if this changes
+bool Camera::beginFrame(const void* source)
+{
+	m_frameTimings = FrameTimings();
+	if (!m_screenBuf.isInitialised())
+		return false;
+	m_frameStartCounters = RayStats::getTotals();
+
+	// Any change to the view (or to what is being traced) means that the earlier passes are out of date
+	if (m_zoomChanged || m_worldTransformChanged || m_objectsMoved || source != m_lastSource)
+		m_refinementPass = 0;
+	m_lastSource = source;
+
+	// Make sure our cached values are up to date (moving the camera without rotating it leaves the world rays unchanged)
+	const bool raysChanged = m_zoomChanged || m_orientationChanged;
+	if (m_zoomChanged)
+	{
+		generateRays();
+		m_zoomChanged = false;
+	}
+	if (m_worldTransformChanged)
+	{
+		updateWorldTransform();
+		m_worldTransformChanged = false;
+	}
+	if (raysChanged)
+	{
+		updateWorldRays();
+		m_orientationChanged = false;
+	}
 
+	// Trace one pixel in every block of stride x stride pixels, skipping those already traced by the previous pass
+	if (m_progressive && m_refinementPass < c_numRefinementPasses)
+	{
+		m_sampleStride = c_refinementStrides[m_refinementPass];
+		m_reusePreviousPass = m_refinementPass > 0;
+	}
+	else
+	{
+		m_sampleStride = 1;
+		m_reusePreviousPass = false;
+	}
+	m_frameTimings.sampleStride = m_sampleStride;
+
+	return !m_pixelRays.empty();
+}
+
+// Moves on to the next refinement pass once a frame is complete
+void Camera::endFrame()
+{
+	m_frameTimings.rayCounters = RayStats::getTotals() - m_frameStartCounters;
+	m_objectsMoved = false;
+	m_imageComplete = m_sampleStride == 1;
+	if (m_progressive && m_refinementPass < c_numRefinementPasses)
+		++m_refinementPass;
 }
 
 // Computes the transformation that will take objects from world to camera coordinates
 // and stores it in m_worldToCameraTransform
 void Camera::updateWorldTransform()
 {
-	// TODO: the following code creates a transform for a camera with translation only
-	// (with the view direction along the negative z-axis); update it to handle rotations, too.
-	m_worldToCameraTransform(0, 3) = -m_position.x;
-	m_worldToCameraTransform(1, 3) = -m_position.y;
-	m_worldToCameraTransform(2, 3) = m_position.z;
-	m_worldToCameraTransform(2, 2) = -1.0f;
+	PROFILE_ZONE("Update world transform");
+
+	// The rows of the rotation are the camera's axes (with the view direction as the z-axis), and the translation moves
+	// the camera to the origin. The transform is rigid, so it is built as one and inverted by transposing.
+	updateBasis();
+	const Vector3D* axes[3] = { &m_right, &m_up, &m_forward };
+	RigidMatrix3D worldToCamera;
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		worldToCamera(i, 0) = axes[i]->x;
+		worldToCamera(i, 1) = axes[i]->y;
+		worldToCamera(i, 2) = axes[i]->z;
+		worldToCamera(i, 3) = -axes[i]->dot(m_position.asVector());
+	}
+
+	m_worldToCameraTransform = worldToCamera.toMatrix();
+	m_cameraToWorldTransform = worldToCamera.inverse().toMatrix();
 }
 
-// Sets the colour of a given pixel on the screen buffer based on the closest object
+// Rotates every pixel's camera space ray direction into world space in one batch, so that tracing in world space doesn't
+// transform each ray every frame. The rotation keeps the directions unit length, so they don't need normalising again.
+// m_cameraToWorldTransform must be up to date (changing the orientation also flags the world transform as changed).
+void Camera::updateWorldRays()
+{
+	PROFILE_ZONE("Transform world rays");
+	m_worldRays.resize(m_pixelRays.size());
+	m_cameraToWorldTransform.transformVectors(m_pixelRays.x(), m_pixelRays.y(), m_pixelRays.z(),
+											  m_worldRays.x(), m_worldRays.y(), m_worldRays.z(), m_pixelRays.size());
+}
+
+// Gets the range of pixels covered by a tile of the view plane.
 // Params:
-//	i, j	Pixel x, y coordinates
-//	object	The first object that the ray from the camera through this pixel intersects
-void Camera::setPixelColourFromObject(unsigned i, unsigned j, const Object * object)
+//	tileIdx			Index of the tile, counting along rows of tiles from the bottom-left of the view plane (input)
+//	tilesX			Number of tiles in each row (input)
+//	iStart, iEnd	Range of pixel x coordinates in the tile (output)
+//	jStart, jEnd	Range of pixel y coordinates in the tile (output)
+void Camera::getTilePixels(unsigned tileIdx, unsigned tilesX, unsigned& iStart, unsigned& iEnd, unsigned& jStart, unsigned& jEnd) const
 {
-	// TODO: update this to make the colouring more interesting!
-	// You may want to pass in extra parameters (e.g. the intersection point)...
-	m_screenBuf.setPixel(i, j, object->m_colour);
+	iStart = (tileIdx % tilesX) * m_tileSize;
+	iEnd = min(iStart + m_tileSize, m_viewPlane.resolutionX);
+	jStart = (tileIdx / tilesX) * m_tileSize;
+	jEnd = min(jStart + m_tileSize, m_viewPlane.resolutionY);
 }
 
-//--------------------------------------------------------------------------------------------------------------------//
+// Gets the pixels in one row of a tile that are traced in the current pass.
+// Returns false if no pixels in the row are traced.
+// Params:
+//	j				Pixel y coordinate of the row (input)
+//	iStart, iEnd	Range of pixel x coordinates in the tile (input)
+//	iFirst			x coordinate of the first pixel to trace (output)
+//	iStep			Distance between pixels to trace (output)
+bool Camera::getRowSamples(unsigned j, unsigned iStart, unsigned iEnd, unsigned& iFirst, unsigned& iStep) const
+{
+	const unsigned stride = m_sampleStride;
+	if (j % stride != 0)
+		return false;
+
+	// Samples are at multiples of the stride; in rows that the previous pass (with twice the stride) also
+	// sampled, every other one has already been traced
+	iFirst = (iStart + stride - 1) / stride * stride;
+	iStep = stride;
+	if (m_reusePreviousPass && j % (2 * stride) == 0)
+	{
+		if (iFirst % (2 * stride) == 0)
+			iFirst += stride;
+		iStep = 2 * stride;
+	}
+	return iFirst < iEnd;
+}
 
-// Returns a pointer to the closest object to the ray source that is intersected by the ray from the given list.
+// Returns the index of the pixel whose traced sample gives the colour of pixel (i, j) in the current pass
+unsigned Camera::getSampleIndex(unsigned i, unsigned j) const
+{
+	return (i - i % m_sampleStride) + m_viewPlane.resolutionX * (j - j % m_sampleStride);
+}
+
+// Finds the closest object to each pixel in a tile of the view plane that is traced in the current pass, storing it in m_pixelHits.
+// Tiles don't overlap, so they can be traced concurrently as long as the objects aren't modified.
+// Returns the number of rays traced.
 // Params:
-//	raySrc	starting point of the ray (input)
-//	rayDir	direction of the ray (input)
-//	objects	list of pointers to objects to test (input)
-const Object* Camera::getClosestIntersectedObject(const Point3D& raySrc, const Vector3D& rayDir, const std::vector<Object*>& objects) const
+//	tileIdx	Index of the tile, counting along rows of tiles from the bottom-left of the view plane
+//	tilesX	Number of tiles in each row
+//	objects	List of pointers to objects to test (in world space if m_transformRays is set, otherwise in camera space)
+unsigned Camera::traceTile(unsigned tileIdx, unsigned tilesX, const std::vector<Object*>& objects)
 {
-	float distToNearestObject = FLT_MAX;
-	const Object* nearestObject = nullptr;
-	for (unsigned objIdx = 0; objIdx < objects.size(); ++objIdx)
+	PROFILE_ZONE("Trace tile");
+	unsigned iStart, iEnd, jStart, jEnd;
+	getTilePixels(tileIdx, tilesX, iStart, iEnd, jStart, jEnd);
+
+	// All rays start at the camera's position
+	const Point3D origin = m_transformRays ? m_cameraToWorldTransform * Point3D() : Point3D();
+
+	// Trace each row of the tile in packets of neighbouring rays, counting the work in this thread's counters
+	// (fetched once for the tile, as finding them is a thread-local lookup)
+	RayCounters& counters = RayStats::local();
+	unsigned raysCast = 0;
+	for (unsigned j = jStart; j < jEnd; ++j)
 	{
-		float distToFirstIntersection = FLT_MAX;
-		if (objects[objIdx]->getIntersection(raySrc, rayDir, distToFirstIntersection)
-			&& distToFirstIntersection < distToNearestObject)
+		unsigned iFirst, iStep;
+		if (!getRowSamples(j, iStart, iEnd, iFirst, iStep))
+			continue;
+
+		for (unsigned packetStart = iFirst; packetStart < iEnd; packetStart += RayPacket::c_maxSize * iStep)
 		{
-			nearestObject = objects[objIdx];
-			distToNearestObject = distToFirstIntersection;
+			unsigned pixelIdx[RayPacket::c_maxSize];
+
+			RayPacket packet;
+			packet.origin = origin;
+			packet.count = min(RayPacket::c_maxSize, (iEnd - packetStart + iStep - 1) / iStep);
+			for (unsigned rayIdx = 0; rayIdx < packet.count; ++rayIdx)
+			{
+				pixelIdx[rayIdx] = packetStart + rayIdx * iStep + m_viewPlane.resolutionX * j;
+				const Vector3D rayDir = m_transformRays ? m_worldRays.getDirection(pixelIdx[rayIdx]) : m_pixelRays.getDirection(pixelIdx[rayIdx]);
+				packet.dirX[rayIdx] = rayDir.x;
+				packet.dirY[rayIdx] = rayDir.y;
+				packet.dirZ[rayIdx] = rayDir.z;
+			}
+			packet.padDirections();
+			raysCast += packet.count;
+
+			// Either way, the objects are intersected with the whole packet at once (using the SIMD kernels for spheres)
+			PacketHits hits;
+			if (m_useBVH)
+			{
+				m_bvh.getClosestPacketIntersections(packet, hits, counters);
+			}
+			else
+			{
+				for (auto obj : objects)
+					obj->getPacketIntersections(packet, hits, counters);
+			}
+
+			for (unsigned rayIdx = 0; rayIdx < packet.count; ++rayIdx)
+			{
+				m_pixelHits[pixelIdx[rayIdx]] = hits.object[rayIdx];
+				hits.object[rayIdx] != nullptr ? ++counters.hits : ++counters.misses;
+			}
+		}
+	}
+
+	counters.primaryRays += raysCast;
+	return raysCast;
+}
+
+// Sets the colour of each pixel in a tile of the view plane based on the closest object found by traceTile.
+// When only some pixels were traced, the others take the colour of the traced pixel at the corner of their block.
+void Camera::shadeTile(unsigned tileIdx, unsigned tilesX)
+{
+	PROFILE_ZONE("Shade tile");
+	unsigned iStart, iEnd, jStart, jEnd;
+	getTilePixels(tileIdx, tilesX, iStart, iEnd, jStart, jEnd);
+
+	for (unsigned j = jStart; j < jEnd; ++j)
+	{
+		for (unsigned i = iStart; i < iEnd; ++i)
+		{
+			const Object* object = m_pixelHits[getSampleIndex(i, j)];
+			if (object != nullptr)
+				setPixelColourFromObject(i, j, object);
+			else
+				m_screenBuf.setPixel(i, j, Colour());
+		}
+	}
+}
+
+// Finds the closest primitive in the scene store to each pixel in a tile of the view plane that is traced in the
+// current pass, storing it in m_sceneHits. Returns the number of rays traced.
+unsigned Camera::traceSceneTile(unsigned tileIdx, unsigned tilesX, const Scene& scene)
+{
+	PROFILE_ZONE("Trace tile");
+	unsigned iStart, iEnd, jStart, jEnd;
+	getTilePixels(tileIdx, tilesX, iStart, iEnd, jStart, jEnd);
+
+	const Point3D origin = m_cameraToWorldTransform * Point3D();
+	RayCounters& counters = RayStats::local();
+	unsigned raysCast = 0, sceneHits = 0;
+	for (unsigned j = jStart; j < jEnd; ++j)
+	{
+		unsigned iFirst, iStep;
+		if (!getRowSamples(j, iStart, iEnd, iFirst, iStep))
+			continue;
+
+		for (unsigned i = iFirst; i < iEnd; i += iStep)
+		{
+			const unsigned idx = i + m_viewPlane.resolutionX * j;
+			const Vector3D rayDir = m_worldRays.getDirection(idx);
+
+			m_sceneHits[idx] = Scene::Hit();
+			scene.getClosestIntersection(origin, rayDir, m_sceneHits[idx], counters);
+			sceneHits += m_sceneHits[idx].type != Scene::PrimitiveType::None;
+			++raysCast;
+		}
+	}
+
+	counters.primaryRays += raysCast;
+	counters.hits += sceneHits;
+	counters.misses += raysCast - sceneHits;
+	return raysCast;
+}
+
+// Sets the colour of each pixel in a tile of the view plane based on the closest primitive found by traceSceneTile
+void Camera::shadeSceneTile(unsigned tileIdx, unsigned tilesX, const Scene& scene)
+{
+	PROFILE_ZONE("Shade tile");
+	unsigned iStart, iEnd, jStart, jEnd;
+	getTilePixels(tileIdx, tilesX, iStart, iEnd, jStart, jEnd);
+
+	for (unsigned j = jStart; j < jEnd; ++j)
+	{
+		for (unsigned i = iStart; i < iEnd; ++i)
+		{
+			const Scene::Hit& hit = m_sceneHits[getSampleIndex(i, j)];
+			m_screenBuf.setPixel(i, j, hit.type != Scene::PrimitiveType::None ? scene.getColour(hit) : Colour());
 		}
 	}
+}
 
-	return nearestObject;		
+// Sets the colour of a given pixel on the screen buffer based on the closest object
+// Params:
+//	i, j	Pixel x, y coordinates
+//	object	The first object that the ray from the camera through this pixel intersects
+void Camera::setPixelColourFromObject(unsigned i, unsigned j, const Object * object)
+{
+	// TODO: update this to make the colouring more interesting!
+	// You may want to pass in extra parameters (e.g. the intersection point)...
+	m_screenBuf.setPixel(i, j, object->getColour());
 }
\ No newline at end of file
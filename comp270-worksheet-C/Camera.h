@@ -1,39 +1,133 @@
 #pragma once
 #include "Matrix3D.h"
+#include "Quaternion.h"
 #include "Image.h"
+#include "ThreadPool.h"
+#include "BVH.h"
+#include "RayBuffer.h"
+#include "Scene.h"
+#include "RayStats.h"
 
 class Object;
 
 class Camera
 {
 public:
+	// Time spent in each phase of the most recent call to updateScreenBuffer
+	struct FrameTimings
+	{
+		double		transformMs = 0.0;	// Updating cached rays and transforms, moving objects and updating the hierarchy
+		double		traceMs = 0.0;		// Finding the closest object to each pixel
+		double		shadeMs = 0.0;		// Setting the pixel colours
+		unsigned	raysCast = 0;		// Number of primary rays traced
+		unsigned	sampleStride = 1;	// One pixel in every sampleStride x sampleStride block was traced (more than 1 during progressive refinement)
+		bool		imageReused = false;	// True if nothing had changed, so the previous image was returned without tracing anything
+		RayCounters	rayCounters;		// Intersection tests made and objects hit (counted by every thread while tracing the frame)
+	};
+
 	void			init(const Point3D& pos);
 	const Image&	updateScreenBuffer(const std::vector<Object*>& objects);
+	const Image&	updateScreenBuffer(const Scene& scene);
+
+	const FrameTimings&	getFrameTimings() const { return m_frameTimings; }
+
+	// Get/set the camera's world space position and orientation
+	const Point3D&		getPosition() const { return m_position; }
+	const Quaternion&	getOrientation() const { return m_orientation; }
+	void				setPosition(const Point3D& position) { m_position = position; m_worldTransformChanged = true; }
+	void				setOrientation(const Quaternion& orientation);
 
 	// Change the camera's world space position
 	void	translateX(float x) { m_position.x += x; m_worldTransformChanged = true; }
 	void	translateY(float y) { m_position.y += y; m_worldTransformChanged = true; }
 	void	translateZ(float z) { m_position.z += z; m_worldTransformChanged = true; }
 
-	// Change the camera's world space rotation
-	void	rotateX(float x) { m_rotation.x += x; m_worldTransformChanged = true; }
-	void	rotateY(float y) { m_rotation.y += y; m_worldTransformChanged = true; }
-	void	rotateZ(float z) { m_rotation.z += z; m_worldTransformChanged = true; }
+	// Rotate the camera about its own x (right), y (up) or z (backward) axis, by the given angle in radians
+	void	rotateX(float x) { rotate(Vector3D(1.0f, 0.0f, 0.0f), x); }
+	void	rotateY(float y) { rotate(Vector3D(0.0f, 1.0f, 0.0f), y); }
+	void	rotateZ(float z) { rotate(Vector3D(0.0f, 0.0f, 1.0f), z); }
+	void	rotate(const Vector3D& localAxis, float angle);
+
+	// Get the world space directions the camera faces and of its right and up axes (its camera space z, x and y axes),
+	// e.g. to build rays without transforming them by a matrix
+	const Vector3D&	getForward() const { updateBasis(); return m_forward; }
+	const Vector3D&	getRight() const { updateBasis(); return m_right; }
+	const Vector3D&	getUp() const { updateBasis(); return m_up; }
 
 	// Change the distance from the camera to the view plane
 	void	zoom(float d) { m_viewPlane.distance += d; m_viewPlane.distance = max(1.0f, m_viewPlane.distance); m_zoomChanged = true; }
 
+	// Get the distance from the camera to the view plane and the view plane's half extents
+	float	getViewPlaneDistance() const { return m_viewPlane.distance; }
+	float	getViewPlaneHalfWidth() const { return m_viewPlane.halfWidth; }
+	float	getViewPlaneHalfHeight() const { return m_viewPlane.halfHeight; }
+
+	// Set the distance from the camera to the view plane and the view plane's half extents
+	void	setViewPlane(float distance, float halfWidth, float halfHeight)
+	{
+		m_viewPlane.distance = max(1.0f, distance);
+		m_viewPlane.halfWidth = halfWidth;
+		m_viewPlane.halfHeight = halfHeight;
+		m_zoomChanged = true;
+	}
+
+	// Set the number of pixels in the x and y directions (the view plane's extents are unchanged)
+	void		setResolution(unsigned resolutionX, unsigned resolutionY);
+	unsigned	getResolutionX() const { return m_viewPlane.resolutionX; }
+	unsigned	getResolutionY() const { return m_viewPlane.resolutionY; }
+
+	// Set the number of threads used to trace the view plane (including the calling thread), and the size of the square tiles it is split into
+	void	setRenderThreadCount(unsigned count) { m_threadPool.setWorkerCount(max(1u, count) - 1); }
+	void	setTileSize(unsigned size) { m_tileSize = max(1u, size); }
+
+	// Choose whether to transform the rays into world space (leaving the objects untouched) or the objects into camera space
+	void	setTransformRays(bool transformRays) { m_transformRays = transformRays; }
+
+	// Choose whether to find the closest object to each ray using a bounding volume hierarchy, or by testing every object
+	void	setUseBVH(bool useBVH) { m_useBVH = useBVH; }
+
+	// Choose whether to render progressively: after the view changes, the first frame traces one pixel in every 4x4 block,
+	// the next one in every 2x2 block, and the next every pixel, so that each frame is quick to produce while the camera moves
+	void	setProgressive(bool progressive) { m_progressive = progressive; m_refinementPass = c_numRefinementPasses; }
+	bool	isProgressive() const { return m_progressive; }
+
+	// Returns true if the most recent image was rendered at less than full pixel density, so later frames will refine it
+	bool	isRefining() const { return m_progressive && m_refinementPass < c_numRefinementPasses; }
+
+	// Notify the camera that objects have moved in world space, so that the hierarchy is refitted before the next frame.
+	// (Changes made through Object's own functions are picked up automatically, using the objects' revisions.)
+	void	objectsMoved() { m_objectsMoved = true; }
+
 private:
+	bool			isImageUpToDate(const void* source) const;
+	const Image&	reuseImage();
+	bool			haveObjectsChanged(const std::vector<Object*>& objects) const;
+	void			recordObjectRevisions(const std::vector<Object*>& objects);
+	bool			beginFrame(const void* source);
+	void			endFrame();
 	void			generateRays();
+	void			generateRays(RayBuffer& rays, const Vector3D& xAxis, const Vector3D& yAxis, const Vector3D& zAxis) const;
+	void			updateBasis() const;
 	void			updateWorldTransform();
+	void			updateWorldRays();
+	unsigned		traceTile(unsigned tileIdx, unsigned tilesX, const std::vector<Object*>& objects);
+	void			shadeTile(unsigned tileIdx, unsigned tilesX);
+	unsigned		traceSceneTile(unsigned tileIdx, unsigned tilesX, const Scene& scene);
+	void			shadeSceneTile(unsigned tileIdx, unsigned tilesX, const Scene& scene);
+	void			getTilePixels(unsigned tileIdx, unsigned tilesX, unsigned& iStart, unsigned& iEnd, unsigned& jStart, unsigned& jEnd) const;
+	bool			getRowSamples(unsigned j, unsigned iStart, unsigned iEnd, unsigned& iFirst, unsigned& iStep) const;
+	unsigned		getSampleIndex(unsigned i, unsigned j) const;
 	void			setPixelColourFromObject(unsigned i, unsigned j, const Object* object);
-	const Object*	getClosestIntersectedObject(const Point3D& raySrc, const Vector3D& rayDir, const std::vector<Object*>& objects) const;
 	
 	Point3D		m_position = Point3D();				// The position (translation) of the camera in world space
-	Vector3D	m_rotation = Vector3D();			// The Euler rotation of the camera in world space
+	Quaternion	m_orientation;						// The rotation of the camera in world space (from looking along the negative z-axis)
+	bool		m_orientationChanged = true;		// Flag indicating whether the orientation has changed since the world rays were generated
+	mutable Vector3D	m_right, m_up, m_forward;	// World space directions of the camera's axes (cached from m_orientation by updateBasis)
+	mutable bool		m_basisValid = false;		// Cleared when m_orientation changes
 	Matrix3D	m_worldToCameraTransform;			// The matrix representing the transformation from world to camera coordinates
+	Matrix3D	m_cameraToWorldTransform;			// The inverse of m_worldToCameraTransform
 	bool		m_worldTransformChanged = true;		// Flag indicating whether the camera's world transform has been updated
-	bool		m_zoomChanged = true;				// Flat indicating whether the view plane distance has changed
+	bool		m_zoomChanged = true;				// Flag indicating whether the view plane distance or resolution has changed
 	
 	// Properties describing the view plane (framing of the picture)
 	struct
@@ -45,6 +139,41 @@ private:
 	}	m_viewPlane;
 
 	// Cached info for generating the image
-	std::vector<std::vector<Vector3D>>	m_pixelRays;	// Stores the directions of rays passing through each pixel of the view plane
+	// (sized to the resolution; shrinking keeps their storage and growing reallocates geometrically, so changing the resolution back and forth doesn't allocate)
+	RayBuffer	m_pixelRays;							// Stores the directions of rays passing through each pixel of the view plane (row by row)
+	RayBuffer	m_worldRays;							// m_pixelRays transformed to world space (updated whenever either changes)
+	std::vector<const Object*>	m_pixelHits;			// Stores the closest object to each pixel (row by row), or null if there isn't one
+	std::vector<Scene::Hit>		m_sceneHits;			// Stores the closest primitive to each pixel when tracing a Scene
 	Image	m_screenBuf;								// Stores the colours of each pixel
+	FrameTimings	m_frameTimings;						// Timings for the most recent frame
+
+	// Settings for tracing the view plane in parallel
+	ThreadPool	m_threadPool;							// Worker threads that trace tiles of the view plane
+	unsigned	m_tileSize = 16;						// Width and height of each tile, in pixels
+	bool		m_transformRays = true;					// If true, rays are transformed to world space so the objects are never modified
+
+	// Acceleration structure for finding the closest object to each ray
+	BVH			m_bvh;									// Hierarchy over the objects (in whichever space they are traced in)
+	bool		m_useBVH = true;						// If true, m_bvh is used instead of testing every object
+	bool		m_objectsMoved = false;					// Flag indicating whether objects have moved since the last frame (so m_bvh needs to be refitted)
+
+	// Record of what the current image shows, so that it can be reused if nothing has changed
+	struct ObjectRevision
+	{
+		const Object*	object;
+		unsigned		revision;
+	};
+	std::vector<ObjectRevision>	m_objectRevisions;		// Revision of each object when it was last traced
+	unsigned	m_sceneRevision = 0;					// Revision of the scene store when it was last traced
+	const void*	m_lastSource = nullptr;					// The objects or scene that the last frame traced
+	bool		m_imageComplete = false;				// Flag indicating whether the last frame traced every pixel
+
+	// Progressive refinement (m_pixelHits/m_sceneHits keep the samples traced by earlier passes)
+	static const unsigned	c_numRefinementPasses = 3;		// Number of passes (see c_refinementStrides in Camera.cpp)
+	bool			m_progressive = false;				// If true, the image is refined over several frames after the view changes
+	unsigned		m_refinementPass = 0;				// Index of the next pass to render (c_numRefinementPasses once the image is complete)
+	unsigned		m_sampleStride = 1;					// Sample spacing for the current frame
+	bool			m_reusePreviousPass = false;		// If true, samples traced by the previous pass are kept rather than traced again
+
+	RayCounters		m_frameStartCounters;				// Totals of every thread's ray counters when the current frame started
 };
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// Fills regs with the results of the cpuid instruction for the given leaf and subleaf
+static void cpuid(int regs[4], int leaf, int subleaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(regs, leaf, subleaf);
+#else
+	unsigned a, b, c, d;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	regs[0] = (int)a; regs[1] = (int)b; regs[2] = (int)c; regs[3] = (int)d;
+#endif
+}
+
+// Returns the register state that the operating system saves on context switches
+static unsigned long long getEnabledXState()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+static CpuFeatures detectFeatures()
+{
+	CpuFeatures features;
+
+	int regs[4];
+	cpuid(regs, 0, 0);
+	const int maxLeaf = regs[0];
+	if (maxLeaf < 1)
+		return features;
+
+	cpuid(regs, 1, 0);
+	features.sse41 = (regs[2] & (1 << 19)) != 0;
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool fma = (regs[2] & (1 << 12)) != 0;
+
+	// The wider registers can only be used if the OS saves them
+	const unsigned long long xstate = osxsave ? getEnabledXState() : 0;
+	const bool avxEnabled = (xstate & 0x6) == 0x6;				// SSE and AVX state
+	const bool avx512Enabled = (xstate & 0xe6) == 0xe6;			// ... plus opmask and upper ZMM state
+
+	if (maxLeaf >= 7)
+	{
+		cpuid(regs, 7, 0);
+		features.avx2 = avxEnabled && (regs[1] & (1 << 5)) != 0;
+		features.avx512f = avx512Enabled && (regs[1] & (1 << 16)) != 0;
+	}
+	features.fma = avxEnabled && fma;
+
+	return features;
+}
+
+// Returns the features of the CPU the program is running on
+const CpuFeatures& CpuFeatures::get()
+{
+	static const CpuFeatures features = detectFeatures();
+	return features;
+}
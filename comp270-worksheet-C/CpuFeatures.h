@@ -0,0 +1,24 @@
+#pragma once
+
+// Instruction set extensions supported by the CPU (and enabled by the operating system), detected once at startup.
+struct CpuFeatures
+{
+	bool	sse41 = false;
+	bool	avx2 = false;
+	bool	fma = false;
+	bool	avx512f = false;
+
+	static const CpuFeatures&	get();
+};
+
+// Marks a function as using the given instruction set, so that it can be compiled without enabling it globally.
+// (MSVC allows any intrinsics to be used, so nothing is needed there.)
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE41	__attribute__((target("sse4.1")))
+#define TARGET_AVX2		__attribute__((target("avx2")))
+#define TARGET_AVX512	__attribute__((target("avx512f")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
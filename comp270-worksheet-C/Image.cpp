@@ -1,7 +1,7 @@
 #include "stdafx.h"
 #include "Image.h"
 
-// Initialises the image to the given dimensions
+// Initialises the image to the given dimensions (reusing the existing storage if it is large enough)
 void Image::init(unsigned width, unsigned height)
 {
 	m_width = width;
@@ -19,8 +19,11 @@ public:
 	unsigned height() const { return m_height; }
 
 	// Get/set the Colour value of the pixel with the given indices
-	const Colour&	getPixel(unsigned i, unsigned j) const { return m_pixels[i + m_height * j]; }
-	void			setPixel(unsigned i, unsigned j, const Colour& col) { m_pixels[i + m_height * j].set(col); }
+	const Colour&	getPixel(unsigned i, unsigned j) const { return m_pixels[i + m_width * j]; }
+	void			setPixel(unsigned i, unsigned j, const Colour& col) { m_pixels[i + m_width * j].set(col); }
+
+	// Direct access to the pixels, stored row by row (increasing j) with m_width pixels per row
+	const Colour*	data() const { return m_pixels.data(); }
 
 	void	clear();
 
@@ -0,0 +1,216 @@
+#include "stdafx.h"
+#include "ImageWriter.h"
+
+namespace
+{
+	// Copies the RGB components of one row of the image (counting from the top of the picture) into the buffer
+	void getRowRGB(const Image& image, unsigned row, std::vector<unsigned char>& rgb)
+	{
+		const Colour* pixels = image.data() + (image.height() - 1 - row) * image.width();
+		rgb.resize(3 * image.width());
+		for (unsigned i = 0; i < image.width(); ++i)
+		{
+			rgb[3 * i] = pixels[i].r;
+			rgb[3 * i + 1] = pixels[i].g;
+			rgb[3 * i + 2] = pixels[i].b;
+		}
+	}
+
+	// Table for the CRC-32 used by PNG chunks
+	struct CrcTable
+	{
+		uint32_t	values[256];
+
+		CrcTable()
+		{
+			for (uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				values[n] = c;
+			}
+		}
+	};
+
+	// Writes PNG chunks to a file, keeping track of each chunk's CRC as its data is written
+	class PngChunkWriter
+	{
+	public:
+		explicit PngChunkWriter(std::ofstream& file) : m_file(file) {}
+
+		void beginChunk(const char* type, uint32_t length)
+		{
+			writeUint32(length);
+			m_crc = 0xffffffffu;
+			write(type, 4);
+		}
+
+		void write(const void* data, size_t size)
+		{
+			static const CrcTable table;
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for (size_t idx = 0; idx < size; ++idx)
+				m_crc = table.values[(m_crc ^ bytes[idx]) & 0xff] ^ (m_crc >> 8);
+			m_file.write(static_cast<const char*>(data), size);
+		}
+
+		void writeUint32(uint32_t value)
+		{
+			const unsigned char bytes[4] = { (unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value };
+			write(bytes, 4);
+		}
+
+		void endChunk()
+		{
+			const uint32_t crc = m_crc ^ 0xffffffffu;
+			const unsigned char bytes[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc };
+			m_file.write(reinterpret_cast<const char*>(bytes), 4);
+		}
+
+	private:
+		std::ofstream&	m_file;
+		uint32_t		m_crc = 0;
+	};
+
+	// Writes data into a zlib stream made of uncompressed ("stored") deflate blocks, inside a PNG chunk.
+	// The total amount of data must be known in advance, so that the chunk's length can be written first.
+	class StoredDeflateWriter
+	{
+	public:
+		static const size_t c_maxBlockSize = 65535;
+
+		StoredDeflateWriter(PngChunkWriter& chunk, size_t totalSize) : m_chunk(chunk), m_remaining(totalSize)
+		{
+			const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+			m_chunk.write(zlibHeader, 2);
+		}
+
+		// Returns the size of the zlib stream holding the given amount of data
+		static size_t getStreamSize(size_t totalSize)
+		{
+			const size_t numBlocks = max((size_t)1, (totalSize + c_maxBlockSize - 1) / c_maxBlockSize);
+			return 2 + 5 * numBlocks + totalSize + 4;
+		}
+
+		void write(const unsigned char* data, size_t size)
+		{
+			while (size > 0)
+			{
+				if (m_blockRemaining == 0)
+					beginBlock();
+
+				const size_t count = min(size, m_blockRemaining);
+				m_chunk.write(data, count);
+				updateAdler(data, count);
+				data += count;
+				size -= count;
+				m_blockRemaining -= count;
+				m_remaining -= count;
+			}
+		}
+
+		void finish()
+		{
+			if (!m_startedBlock)
+				beginBlock();
+			m_chunk.writeUint32((m_adlerB << 16) | m_adlerA);
+		}
+
+	private:
+		void beginBlock()
+		{
+			m_blockRemaining = min(m_remaining, c_maxBlockSize);
+			const uint16_t length = (uint16_t)m_blockRemaining;
+			const unsigned char header[5] = { (unsigned char)(m_remaining == m_blockRemaining ? 1 : 0),
+				(unsigned char)length, (unsigned char)(length >> 8), (unsigned char)~length, (unsigned char)(~length >> 8) };
+			m_chunk.write(header, 5);
+			m_startedBlock = true;
+		}
+
+		void updateAdler(const unsigned char* data, size_t size)
+		{
+			for (size_t idx = 0; idx < size; ++idx)
+			{
+				m_adlerA = (m_adlerA + data[idx]) % 65521;
+				m_adlerB = (m_adlerB + m_adlerA) % 65521;
+			}
+		}
+
+		PngChunkWriter&	m_chunk;
+		size_t			m_remaining;			// Bytes still to be written in total
+		size_t			m_blockRemaining = 0;	// Bytes still to be written in the current block
+		bool			m_startedBlock = false;
+		uint32_t		m_adlerA = 1, m_adlerB = 0;
+	};
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Writes the image as a binary PPM (P6) file. Returns false if the file can't be written.
+bool ImageWriter::writePPM(const char* path, const Image& image)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	file << "P6\n" << image.width() << " " << image.height() << "\n255\n";
+
+	std::vector<unsigned char> rgb;
+	for (unsigned row = 0; row < image.height(); ++row)
+	{
+		getRowRGB(image, row, rgb);
+		file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+	}
+
+	return file.good();
+}
+
+// Writes the image as an RGB PNG file. The image data is stored without compression, which keeps writing
+// quick and simple at the cost of file size. Returns false if the file can't be written.
+bool ImageWriter::writePNG(const char* path, const Image& image)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	PngChunkWriter chunk(file);
+	chunk.beginChunk("IHDR", 13);
+	chunk.writeUint32(image.width());
+	chunk.writeUint32(image.height());
+	const unsigned char format[5] = { 8, 2, 0, 0, 0 };	// 8 bits per channel, RGB, deflate, no filtering, not interlaced
+	chunk.write(format, sizeof(format));
+	chunk.endChunk();
+
+	// Each row is preceded by its filter type (0, i.e. none)
+	const size_t dataSize = (size_t)image.height() * (1 + 3 * (size_t)image.width());
+	chunk.beginChunk("IDAT", (uint32_t)StoredDeflateWriter::getStreamSize(dataSize));
+	StoredDeflateWriter deflate(chunk, dataSize);
+	std::vector<unsigned char> rgb;
+	for (unsigned row = 0; row < image.height(); ++row)
+	{
+		const unsigned char filterType = 0;
+		deflate.write(&filterType, 1);
+		getRowRGB(image, row, rgb);
+		deflate.write(rgb.data(), rgb.size());
+	}
+	deflate.finish();
+	chunk.endChunk();
+
+	chunk.beginChunk("IEND", 0);
+	chunk.endChunk();
+
+	return file.good();
+}
+
+// Writes the image in the format given by the file extension
+bool ImageWriter::write(const char* path, const Image& image)
+{
+	const size_t length = strlen(path);
+	if (length >= 4 && (strcmp(path + length - 4, ".png") == 0 || strcmp(path + length - 4, ".PNG") == 0))
+		return writePNG(path, image);
+	return writePPM(path, image);
+}
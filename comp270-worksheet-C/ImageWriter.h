@@ -0,0 +1,14 @@
+#pragma once
+#include "Image.h"
+
+// Functions for saving images to disk.
+// Rows are converted and written one at a time, straight from the image, and the top row of the picture
+// (the last row of the Image, since its row 0 is the bottom of the view plane) is written first.
+namespace ImageWriter
+{
+	bool	writePPM(const char* path, const Image& image);
+	bool	writePNG(const char* path, const Image& image);
+
+	// Chooses the format from the file extension (.png for PNG, otherwise PPM)
+	bool	write(const char* path, const Image& image);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+// A read-only view of a file's contents, mapped into memory by the operating system so that it can be
+// used without reading it into a buffer first (pages are loaded on demand as they are touched).
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool	open(const char* path);
+	void	close();
+
+	bool		isOpen() const { return m_data != nullptr; }
+	const char*	data() const { return m_data; }
+	size_t		size() const { return m_size; }
+
+private:
+	const char*	m_data = nullptr;	// Start of the mapped contents (page aligned)
+	size_t		m_size = 0;			// Size of the file in bytes
+
+#ifdef _WIN32
+	HANDLE		m_file = INVALID_HANDLE_VALUE;
+	HANDLE		m_mapping = NULL;
+#endif
+};
\ No newline at end of file
@@ -1,23 +1,68 @@
 #include "stdafx.h"
 #include "Matrix3D.h"
+#include "CpuFeatures.h"
+#include <immintrin.h>
 
 //--------------------------------------------------------------------------------------------------------------------//
 
 // Returns the inverse of this transformation matrix, such that this * this->inverseTransform() gives the identity matrix.
+// The matrix must represent an affine transformation (rotation, translation, scale), i.e. its bottom row is 0, 0, 0, 1.
 Matrix3D Matrix3D::inverseTransform() const
 {
-	Matrix3D inverse;
-	
-	// TODO: the following code will invert a matrix that only performs a translation and z-axis flip;
-	// update it to handle a general matrix representing affine transformations (rotation, translation, scale).
-	inverse(0, 3) = -m_[0][3];
-	inverse(1, 3) = -m_[1][3];
-	inverse(2, 3) = m_[2][3];
-	inverse(2, 2) = -1.0f;
+	updateInverse();
 
+	Matrix3D inverse;
+	memcpy(inverse.m_, m_inverse, sizeof(m_inverse));
+	memcpy(inverse.m_inverse, m_, sizeof(m_));
+	inverse.m_inverseValid = true;
 	return inverse;
 }
 
+// Computes m_inverse if it isn't already up to date.
+// The inverse of the upper 3x3 block A is the transpose of its cofactor matrix divided by its determinant;
+// for an affine matrix with rows r0, r1, r2 the columns of that are the cross products r1 x r2, r2 x r0 and r0 x r1.
+// The inverse's translation is then -inverse(A) * t, where t is this matrix's translation.
+void Matrix3D::updateInverse() const
+{
+	if (m_inverseValid)
+		return;
+
+	// Each row holds three components of A, plus one component of the translation
+	const __m128 row0 = _mm_loadu_ps(m_[0]);
+	const __m128 row1 = _mm_loadu_ps(m_[1]);
+	const __m128 row2 = _mm_loadu_ps(m_[2]);
+
+	// Columns of the inverse of A (before dividing by the determinant); their w components are zero
+	__m128 col0 = VectorMath::cross3(row1, row2);
+	__m128 col1 = VectorMath::cross3(row2, row0);
+	__m128 col2 = VectorMath::cross3(row0, row1);
+
+	// The determinant of A is r0 . (r1 x r2) (col0.w is zero, so r0's translation doesn't contribute)
+	__m128 det = _mm_mul_ps(row0, col0);
+	det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(2, 3, 0, 1)));
+	det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(1, 0, 3, 2)));
+	const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	col0 = _mm_mul_ps(col0, invDet);
+	col1 = _mm_mul_ps(col1, invDet);
+	col2 = _mm_mul_ps(col2, invDet);
+
+	// Translation: -(col0 * t.x + col1 * t.y + col2 * t.z)
+	__m128 translation = _mm_mul_ps(col0, _mm_set1_ps(m_[0][3]));
+	translation = _mm_add_ps(translation, _mm_mul_ps(col1, _mm_set1_ps(m_[1][3])));
+	translation = _mm_add_ps(translation, _mm_mul_ps(col2, _mm_set1_ps(m_[2][3])));
+	translation = _mm_sub_ps(_mm_setzero_ps(), translation);
+
+	// Transposing the columns (with the translation as the fourth column) gives the inverse's rows
+	_MM_TRANSPOSE4_PS(col0, col1, col2, translation);
+	_mm_storeu_ps(m_inverse[0], col0);
+	_mm_storeu_ps(m_inverse[1], col1);
+	_mm_storeu_ps(m_inverse[2], col2);
+	m_inverse[3][0] = m_inverse[3][1] = m_inverse[3][2] = 0.0f;
+	m_inverse[3][3] = 1.0f;
+
+	m_inverseValid = true;
+}
+
 //--------------------------------------------------------------------------------------------------------------------//
 
 // Multiplies the components of a point/vector
@@ -32,3 +77,106 @@ void Matrix3D::multiply(float & x, float & y, float & z, float & w) const
 	z = z_;
 	w = w_;
 }
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Batched transforms of structure-of-arrays points and vectors. Each output component is a row of the matrix dotted with
+// the input (plus the translation for points), computed for 4 or 8 inputs at a time with the matrix components broadcast
+// across registers. The remainder that doesn't fill a register is done one at a time with the same arithmetic.
+// The products are added in the same order as in multiply, so the results are identical to operator*. (Fused multiply-adds
+// would be no faster, as the loops are limited by loading and storing, and would change the results by a few ulps.)
+
+// Transforms inputs [first, count) without SIMD
+template <bool isPoint>
+static void transformArraysScalar(const float (&m)[4][4], const float* x, const float* y, const float* z,
+								  float* outX, float* outY, float* outZ, unsigned first, unsigned count)
+{
+	for (unsigned idx = first; idx < count; ++idx)
+	{
+		const float px = x[idx], py = y[idx], pz = z[idx];
+		outX[idx] = m[0][0] * px + m[0][1] * py + m[0][2] * pz + (isPoint ? m[0][3] : 0.0f);
+		outY[idx] = m[1][0] * px + m[1][1] * py + m[1][2] * pz + (isPoint ? m[1][3] : 0.0f);
+		outZ[idx] = m[2][0] * px + m[2][1] * py + m[2][2] * pz + (isPoint ? m[2][3] : 0.0f);
+	}
+}
+
+// 4 at a time, with SSE (available on every x64 CPU)
+template <bool isPoint>
+static void transformArraysSSE(const float (&m)[4][4], const float* x, const float* y, const float* z,
+							   float* outX, float* outY, float* outZ, unsigned count)
+{
+	__m128 row[3][4];
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		for (unsigned j = 0; j < 4; ++j)
+			row[i][j] = _mm_set1_ps(isPoint || j < 3 ? m[i][j] : 0.0f);
+	}
+
+	unsigned idx = 0;
+	for (; idx + 4 <= count; idx += 4)
+	{
+		const __m128 px = _mm_loadu_ps(x + idx), py = _mm_loadu_ps(y + idx), pz = _mm_loadu_ps(z + idx);
+		__m128 result[3];
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			result[i] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(row[i][0], px), _mm_mul_ps(row[i][1], py)),
+											  _mm_mul_ps(row[i][2], pz)), row[i][3]);
+		}
+		_mm_storeu_ps(outX + idx, result[0]);
+		_mm_storeu_ps(outY + idx, result[1]);
+		_mm_storeu_ps(outZ + idx, result[2]);
+	}
+	transformArraysScalar<isPoint>(m, x, y, z, outX, outY, outZ, idx, count);
+}
+
+// 8 at a time, with AVX2
+template <bool isPoint>
+TARGET_AVX2 static void transformArraysAVX2(const float (&m)[4][4], const float* x, const float* y, const float* z,
+											float* outX, float* outY, float* outZ, unsigned count)
+{
+	__m256 row[3][4];
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		for (unsigned j = 0; j < 4; ++j)
+			row[i][j] = _mm256_set1_ps(isPoint || j < 3 ? m[i][j] : 0.0f);
+	}
+
+	unsigned idx = 0;
+	for (; idx + 8 <= count; idx += 8)
+	{
+		const __m256 px = _mm256_loadu_ps(x + idx), py = _mm256_loadu_ps(y + idx), pz = _mm256_loadu_ps(z + idx);
+		__m256 result[3];
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			result[i] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(row[i][0], px), _mm256_mul_ps(row[i][1], py)),
+													_mm256_mul_ps(row[i][2], pz)), row[i][3]);
+		}
+		_mm256_storeu_ps(outX + idx, result[0]);
+		_mm256_storeu_ps(outY + idx, result[1]);
+		_mm256_storeu_ps(outZ + idx, result[2]);
+	}
+	transformArraysScalar<isPoint>(m, x, y, z, outX, outY, outZ, idx, count);
+}
+
+static const bool s_useAVX2 = CpuFeatures::get().avx2;
+
+// Params:
+//	x, y, z					components of the points to transform (input)
+//	outX, outY, outZ		components of the transformed points (output)
+//	count					number of points
+void Matrix3D::transformPoints(const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, unsigned count) const
+{
+	if (s_useAVX2)
+		transformArraysAVX2<true>(m_, x, y, z, outX, outY, outZ, count);
+	else
+		transformArraysSSE<true>(m_, x, y, z, outX, outY, outZ, count);
+}
+
+// As transformPoints, but ignoring the translation
+void Matrix3D::transformVectors(const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, unsigned count) const
+{
+	if (s_useAVX2)
+		transformArraysAVX2<false>(m_, x, y, z, outX, outY, outZ, count);
+	else
+		transformArraysSSE<false>(m_, x, y, z, outX, outY, outZ, count);
+}
\ No newline at end of file
@@ -13,8 +13,10 @@ public:
 	}
 
 	// Writable accessor for individual components.
+	// The component may be changed through the returned reference, so the cached inverse is discarded.
 	float& operator()(unsigned i, unsigned j)
 	{
+		m_inverseValid = false;
 		return m_[i][j];
 	}
 
@@ -45,14 +47,36 @@ public:
 		return result;
 	}
 
+	// Apply this matrix to count points (w = 1) or vectors (w = 0) stored as separate x, y and z arrays, writing the results
+	// to the out arrays (which may be the input arrays, to transform in place). The matrix must be affine (see inverseTransform).
+	// The results are identical to operator*'s (AVX2 is used where the CPU supports it, and SSE otherwise).
+	void transformPoints(const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, unsigned count) const;
+	void transformVectors(const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, unsigned count) const;
+
 	Matrix3D inverseTransform() const;
 
+	// Apply the inverse-transpose of this matrix to a surface normal, so that it stays perpendicular to the
+	// transformed surface (the result is not normalised)
+	Vector3D transformNormal(const Vector3D& normal) const
+	{
+		updateInverse();
+		return Vector3D(m_inverse[0][0] * normal.x + m_inverse[1][0] * normal.y + m_inverse[2][0] * normal.z,
+						m_inverse[0][1] * normal.x + m_inverse[1][1] * normal.y + m_inverse[2][1] * normal.z,
+						m_inverse[0][2] * normal.x + m_inverse[1][2] * normal.y + m_inverse[2][2] * normal.z);
+	}
+
 private:
 	float	m_[4][4] = {	{ 1.0f, 0.0f, 0.0f, 0.0f },
 							{ 0.0f, 1.0f, 0.0f, 0.0f },
 							{ 0.0f, 0.0f, 1.0f, 0.0f },
 							{ 0.0f, 0.0f, 0.0f, 1.0f } };
 
+	// The inverse is computed the first time it is needed and kept until a component changes.
+	// The inverse-transpose is read from the same values, with the indices swapped.
+	// Note that this makes the first call to inverseTransform/transformNormal unsafe to make from several threads at once.
+	mutable float	m_inverse[4][4];
+	mutable bool	m_inverseValid = false;
+
 	void multiply(float& x, float& y, float& z, float& w) const;
-									
+	void updateInverse() const;
 };
\ No newline at end of file
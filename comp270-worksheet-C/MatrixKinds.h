@@ -0,0 +1,214 @@
+#pragma once
+#include "Matrix3D.h"
+
+// The structure of a transformation matrix, from the most constrained to the least. Each kind includes the ones before it.
+enum class MatrixKind
+{
+	Translation,	// Identity 3x3 block, plus a translation
+	Rigid,			// Orthonormal 3x3 block (a rotation, possibly combined with a reflection), plus a translation
+	Affine,			// Any invertible 3x3 block, plus a translation
+	Projective		// Any 4x4 matrix
+};
+
+// Returns the kind of the product of two matrices (the least constrained of the two)
+constexpr MatrixKind combineKinds(MatrixKind a, MatrixKind b)
+{
+	return a > b ? a : b;
+}
+
+// A transformation matrix whose kind is known at compile time, so that each operation only does the work that kind needs:
+// only projective matrices store (or use) a bottom row, a translation's 3x3 block is never multiplied by, and rigid
+// matrices are inverted by transposing. Points are assumed to have w = 1 and vectors w = 0, as Point3D and Vector3D do.
+// The caller is responsible for keeping the components consistent with the kind (e.g. a rigid matrix's 3x3 block orthonormal).
+// Convert to a Matrix3D (with toMatrix) to pass the transform to code that takes any matrix.
+template <MatrixKind Kind>
+class KindMatrix3D
+{
+public:
+	static const unsigned c_rows = Kind == MatrixKind::Projective ? 4 : 3;	// Number of rows stored
+
+	// Creates an identity matrix
+	KindMatrix3D()
+	{
+		for (unsigned i = 0; i < c_rows; ++i)
+		{
+			for (unsigned j = 0; j < 4; ++j)
+				m_[i][j] = i == j ? 1.0f : 0.0f;
+		}
+	}
+
+	// Copy the components of a general matrix, which must be of this kind
+	explicit KindMatrix3D(const Matrix3D& matrix)
+	{
+		for (unsigned i = 0; i < c_rows; ++i)
+		{
+			for (unsigned j = 0; j < 4; ++j)
+				m_[i][j] = matrix(i, j);
+		}
+	}
+
+	// Const accessor for individual components (including the implicit ones)
+	float operator()(unsigned i, unsigned j) const
+	{
+		if (Kind == MatrixKind::Translation && j < 3)
+			return i == j ? 1.0f : 0.0f;
+		return i < c_rows ? m_[i][j] : (j == 3 ? 1.0f : 0.0f);
+	}
+
+	// Writable accessor for the stored components (i must be less than c_rows)
+	float& operator()(unsigned i, unsigned j)
+	{
+		return m_[i][j];
+	}
+
+	Vector3D	getTranslation() const { return Vector3D(m_[0][3], m_[1][3], m_[2][3]); }
+	void		setTranslation(const Vector3D& translation) { m_[0][3] = translation.x; m_[1][3] = translation.y; m_[2][3] = translation.z; }
+
+	// Apply this matrix to a point
+	Point3D operator*(const Point3D& pt) const
+	{
+		Point3D result;
+		if (Kind == MatrixKind::Projective)
+			VectorMath::store(&result.x, multiplyProjective(VectorMath::load(&pt.x)));
+		else if (Kind == MatrixKind::Translation)
+			VectorMath::store(&result.x, _mm_add_ps(VectorMath::load(&pt.x), getColumn(3, 0.0f)));
+		else
+			VectorMath::store(&result.x, _mm_add_ps(multiplyBlock(VectorMath::load(&pt.x)), getColumn(3, 1.0f)));
+		return result;
+	}
+
+	// Apply this matrix to a vector
+	Vector3D operator*(const Vector3D& vec) const
+	{
+		if (Kind == MatrixKind::Translation)
+			return vec;
+
+		Vector3D result;
+		if (Kind == MatrixKind::Projective)
+			VectorMath::store(&result.x, multiplyProjective(VectorMath::load(&vec.x)));
+		else
+			VectorMath::store(&result.x, multiplyBlock(VectorMath::load(&vec.x)));
+		return result;
+	}
+
+	// Apply another matrix to this one, giving a matrix of the less constrained of the two kinds
+	template <MatrixKind RightKind>
+	KindMatrix3D<combineKinds(Kind, RightKind)> operator*(const KindMatrix3D<RightKind>& right) const
+	{
+		// Each row of the result is built in a register and stored whole (writing the components one at a time would leave
+		// them to be copied out of the result in 16-byte pieces, which stalls on store forwarding).
+		KindMatrix3D<combineKinds(Kind, RightKind)> result;
+		if (Kind == MatrixKind::Projective || RightKind == MatrixKind::Projective)
+		{
+			// Every row of the result is a combination of all four of the right matrix's rows
+			for (unsigned i = 0; i < result.c_rows; ++i)
+			{
+				__m128 row = _mm_mul_ps(_mm_set1_ps((*this)(i, 0)), right.getRow(0));
+				row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps((*this)(i, 1)), right.getRow(1)));
+				row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps((*this)(i, 2)), right.getRow(2)));
+				row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps((*this)(i, 3)), right.getRow(3)));
+				VectorMath::store(result.m_[i], row);
+			}
+			return result;
+		}
+
+		// The 3x3 blocks multiply (unless one is the identity), and the right matrix's translation is transformed by this one.
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			__m128 row;
+			if (Kind == MatrixKind::Translation)
+				row = _mm_add_ps(VectorMath::load(right.m_[i]), _mm_setr_ps(0.0f, 0.0f, 0.0f, m_[i][3]));
+			else if (RightKind == MatrixKind::Translation)
+				row = _mm_setr_ps(m_[i][0], m_[i][1], m_[i][2], m_[i][0] * right.m_[0][3] + m_[i][1] * right.m_[1][3] + m_[i][2] * right.m_[2][3] + m_[i][3]);
+			else
+			{
+				row = _mm_mul_ps(_mm_set1_ps(m_[i][0]), VectorMath::load(right.m_[0]));
+				row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(m_[i][1]), VectorMath::load(right.m_[1])));
+				row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(m_[i][2]), VectorMath::load(right.m_[2])));
+				row = _mm_add_ps(row, _mm_setr_ps(0.0f, 0.0f, 0.0f, m_[i][3]));
+			}
+			VectorMath::store(result.m_[i], row);
+		}
+		return result;
+	}
+
+	// Returns the inverse of this matrix, which is of the same kind
+	KindMatrix3D inverse() const
+	{
+		static_assert(Kind != MatrixKind::Projective, "Only translation, rigid and affine matrices can be inverted");
+
+		KindMatrix3D result;
+		if (Kind == MatrixKind::Affine)
+			return KindMatrix3D(toMatrix().inverseTransform());
+
+		// A rigid block's inverse is its transpose (and a translation's block is the identity, which needs nothing doing)
+		if (Kind == MatrixKind::Rigid)
+		{
+			for (unsigned i = 0; i < 3; ++i)
+			{
+				for (unsigned j = 0; j < 3; ++j)
+					result.m_[i][j] = m_[j][i];
+			}
+		}
+
+		// The inverse's translation undoes this one's: -(inverse block * translation)
+		const Vector3D translation = result * getTranslation();
+		result.setTranslation(translation * -1.0f);
+		return result;
+	}
+
+	// Returns the equivalent general matrix
+	Matrix3D toMatrix() const
+	{
+		Matrix3D matrix;
+		for (unsigned i = 0; i < c_rows; ++i)
+		{
+			for (unsigned j = 0; j < 4; ++j)
+				matrix(i, j) = (*this)(i, j);
+		}
+		return matrix;
+	}
+
+private:
+	template <MatrixKind> friend class KindMatrix3D;
+
+	// Returns the top three components of column j, with the given w
+	__m128 getColumn(unsigned j, float w) const
+	{
+		return _mm_setr_ps(m_[0][j], m_[1][j], m_[2][j], w);
+	}
+
+	// Multiplies the x, y and z of v by the 3x3 block, giving w = 0 (only used by kinds whose block isn't the identity).
+	// The columns are scaled and summed in x, y, z order, so the result matches Matrix3D bit for bit.
+	__m128 multiplyBlock(__m128 v) const
+	{
+		__m128 result = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), getColumn(0, 0.0f));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), getColumn(1, 0.0f)));
+		return _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), getColumn(2, 0.0f)));
+	}
+
+	// Returns row i, including the implicit components
+	__m128 getRow(unsigned i) const
+	{
+		if (Kind == MatrixKind::Translation || i >= c_rows)
+			return _mm_setr_ps((*this)(i, 0), (*this)(i, 1), (*this)(i, 2), (*this)(i, 3));
+		return VectorMath::load(m_[i]);
+	}
+
+	// Multiplies v (including its w) by the whole of a projective matrix, summing the columns in the same order as Matrix3D
+	__m128 multiplyProjective(__m128 v) const
+	{
+		__m128 result = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), getColumn(0, (*this)(3, 0)));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), getColumn(1, (*this)(3, 1))));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), getColumn(2, (*this)(3, 2))));
+		return _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), getColumn(3, (*this)(3, 3))));
+	}
+
+	// Rows of the matrix; the bottom row of all but projective matrices is always 0, 0, 0, 1, so it isn't stored
+	float	m_[c_rows][4];
+};
+
+typedef KindMatrix3D<MatrixKind::Translation>	TranslationMatrix3D;
+typedef KindMatrix3D<MatrixKind::Rigid>			RigidMatrix3D;
+typedef KindMatrix3D<MatrixKind::Affine>		AffineMatrix3D;
+typedef KindMatrix3D<MatrixKind::Projective>	ProjectiveMatrix3D;
\ No newline at end of file
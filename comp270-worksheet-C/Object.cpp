@@ -1,12 +1,49 @@
 #include "stdafx.h"
 #include "Object.h"
+#include "SphereKernels.h"
+#include "RayStats.h"
+
+// Intersects each ray in the packet with the object in turn.
+// Params:
+//	packet		the rays to test (input)
+//	hits		closest intersection so far for each ray, replaced where this object is closer (input/output)
+//	counters	the calling thread's ray counters, which the tests are added to (input/output)
+void Object::getPacketIntersections(const RayPacket& packet, PacketHits& hits, RayCounters& counters) const
+{
+	for (unsigned idx = 0; idx < packet.count; ++idx)
+	{
+		float distToFirstIntersection = FLT_MAX;
+		if (getIntersection(packet.origin, Vector3D(packet.dirX[idx], packet.dirY[idx], packet.dirZ[idx]), distToFirstIntersection, counters)
+			&& distToFirstIntersection < hits.distance[idx])
+		{
+			hits.distance[idx] = distToFirstIntersection;
+			hits.object[idx] = this;
+		}
+	}
+}
+
+// Returns the cached bounds, recomputing them first if the object has changed since they were last computed.
+const AABB& Object::getWorldBounds() const
+{
+	if (!m_boundsValid)
+	{
+		m_bounds = AABB();
+		m_bounded = computeBounds(m_bounds);
+		if (!m_bounded)
+			m_bounds = AABB();
+		m_boundsValid = true;
+	}
+	return m_bounds;
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
 
 // Plane constructor. Params are:
 //	centrePoint		The point on the plane from which the width and height limits are measured
 //	n				The unit vector that is normal to the plane (in world space)
 //	up				The unit vector along which the plane height is measured (in world space; should be orthogonal to the normal)
 //	w, h			The width and height of the plane (zero/negative for an infinite plane)
-Plane::Plane(Point3D centrePoint, Vector3D n, Vector3D up, float w, float h) :
+Plane::Plane(const Point3D& centrePoint, const Vector3D& n, const Vector3D& up, float w, float h) :
 	Object(centrePoint),
 	m_hDir(up),
 	m_normal(n),
@@ -23,12 +60,65 @@ Plane::Plane(Point3D centrePoint, Vector3D n, Vector3D up, float w, float h) :
 //	raySrc					starting point of the ray (input)
 //	rayDir					direction of the ray (input)
 //	distToFirstIntersection	distance along the ray from the starting point of the first intersection with the plane (output)
-bool Plane::getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection) const
+//	counters				the calling thread's ray counters, which the test is added to (input/output)
+bool Plane::getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection, RayCounters& counters) const
 {
-	// TODO: implement the ray-plane intersection test, returning true if the ray passes through the plane at a
-	// point within the width/height bounds (if applicable).
-	
-	return false;
+	++counters.planeTests;
+
+	// Find where the ray meets the plane (rays parallel to it never do)
+	const float denom = rayDir.dot(m_normal);
+	const Vector3D srcToCentre = m_centre - raySrc;
+	const float dist = srcToCentre.dot(m_normal) / denom;
+
+	// Find the intersection's position relative to the centre, along the width and height directions
+	const float u = dist * rayDir.dot(m_wDir) - srcToCentre.dot(m_wDir);
+	const float v = dist * rayDir.dot(m_hDir) - srcToCentre.dot(m_hDir);
+
+	// The conditions are combined without short-circuiting, as Plane::getPacketIntersections and
+	// Scene::getClosestPlane do (a dimension of zero or less leaves the plane unlimited in that direction)
+	const bool hit = (denom != 0.0f) & (dist > 0.0f)
+		& ((m_halfWidth <= 0.0f) | (fabsf(u) <= m_halfWidth))
+		& ((m_halfHeight <= 0.0f) | (fabsf(v) <= m_halfHeight));
+	if (hit)
+		distToFirstIntersection = dist;
+	return hit;
+}
+
+// Intersects every ray in the packet with this plane, using the same calculation as Plane::getIntersection.
+// The loop has no data-dependent branches (results are selected rather than branched on), so the compiler can vectorise it.
+void Plane::getPacketIntersections(const RayPacket& packet, PacketHits& hits, RayCounters& counters) const
+{
+	counters.planeTests += packet.count;
+
+	// The parts that don't depend on the ray direction are the same for the whole packet
+	const Vector3D srcToCentre = m_centre - packet.origin;
+	const float srcToCentreN = srcToCentre.dot(m_normal);
+	const float srcToCentreW = srcToCentre.dot(m_wDir);
+	const float srcToCentreH = srcToCentre.dot(m_hDir);
+	const bool unlimitedWidth = m_halfWidth <= 0.0f, unlimitedHeight = m_halfHeight <= 0.0f;
+
+	bool closer[RayPacket::c_maxSize];
+	const unsigned count = packet.count;
+	for (unsigned idx = 0; idx < count; ++idx)
+	{
+		const float dirX = packet.dirX[idx], dirY = packet.dirY[idx], dirZ = packet.dirZ[idx];
+		const float denom = dirX * m_normal.x + dirY * m_normal.y + dirZ * m_normal.z;
+		const float dist = srcToCentreN / denom;
+		const float u = dist * (dirX * m_wDir.x + dirY * m_wDir.y + dirZ * m_wDir.z) - srcToCentreW;
+		const float v = dist * (dirX * m_hDir.x + dirY * m_hDir.y + dirZ * m_hDir.z) - srcToCentreH;
+
+		closer[idx] = (denom != 0.0f) & (dist > 0.0f)
+			& (unlimitedWidth | (fabsf(u) <= m_halfWidth))
+			& (unlimitedHeight | (fabsf(v) <= m_halfHeight))
+			& (dist < hits.distance[idx]);
+		hits.distance[idx] = closer[idx] ? dist : hits.distance[idx];
+	}
+
+	for (unsigned idx = 0; idx < count; ++idx)
+	{
+		if (closer[idx])
+			hits.object[idx] = this;
+	}
 }
 
 //--------------------------------------------------------------------------------------------------------------------//
@@ -39,16 +129,44 @@ void Plane::applyTransformation(const Matrix3D & matrix)
 	m_centre = matrix * m_centre;
 	m_hDir = matrix * m_hDir;
 	m_wDir = matrix * m_wDir;
-	m_normal = matrix.inverseTransform() * m_normal;
+	m_normal = matrix.transformNormal(m_normal);
+	m_normal.normalise();
+	++m_revision;
+	invalidateBounds();
+}
+
+// Sets bounds to the box enclosing the plane's rectangle, or returns false if the plane is infinite.
+bool Plane::computeBounds(AABB& bounds) const
+{
+	if (m_halfWidth <= 0.0f || m_halfHeight <= 0.0f)
+		return false;
+
+	// Extent of the rectangle along each axis from its centre
+	Vector3D extent(fabsf(m_wDir.x) * m_halfWidth + fabsf(m_hDir.x) * m_halfHeight,
+					fabsf(m_wDir.y) * m_halfWidth + fabsf(m_hDir.y) * m_halfHeight,
+					fabsf(m_wDir.z) * m_halfWidth + fabsf(m_hDir.z) * m_halfHeight);
+	bounds = AABB(m_centre + extent * -1.0f, m_centre + extent);
+	return true;
+}
+
+// Adds a copy of the plane to the scene store.
+void Plane::addToScene(Scene& scene) const
+{
+	scene.addPlane(m_centre, m_normal, m_wDir, m_hDir, m_halfWidth, m_halfHeight, m_colour);
 }
 
+//--------------------------------------------------------------------------------------------------------------------//
+
 // Returns true if the ray intersects with this sphere.
 // Params:
 //	raySrc					starting point of the ray (input)
 //	rayDir					direction of the ray (input)
 //	distToFirstIntersection	distance along the ray from the starting point of the first intersection with the sphere (output)
-bool Sphere::getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection) const
+//	counters				the calling thread's ray counters, which the test is added to (input/output)
+bool Sphere::getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection, RayCounters& counters) const
 {
+	++counters.sphereTests;
+
 	// Find the point on the ray closest to the sphere's centre
 	Vector3D srcToCentre = m_centre - raySrc;
 	float tc = srcToCentre.dot(rayDir);
@@ -59,7 +177,7 @@ bool Sphere::getIntersection(const Point3D& raySrc, const Vector3D& rayDir, floa
 		float distSq = srcToCentre.dot(srcToCentre) - tc * tc;
 		if (distSq < m_radius2)
 		{
-			distToFirstIntersection = tc - sqrt(m_radius2 - distSq);
+			distToFirstIntersection = tc - sqrtf(m_radius2 - distSq);
 			return true;
 		}
 	}
@@ -67,8 +185,32 @@ bool Sphere::getIntersection(const Point3D& raySrc, const Vector3D& rayDir, floa
 	return false;
 }
 
+// Intersects every ray in the packet with this sphere at once, using the fastest SIMD kernel the CPU supports.
+void Sphere::getPacketIntersections(const RayPacket& packet, PacketHits& hits, RayCounters& counters) const
+{
+	counters.sphereTests += packet.count;
+	SphereKernels::getActiveKernel()(packet, m_centre, m_radius2, this, hits);
+}
+
 // Transforms the object using the given matrix.
 void Sphere::applyTransformation(const Matrix3D & matrix)
 {
 	m_centre = matrix * m_centre;
+	++m_revision;
+	invalidateBounds();
+}
+
+// Sets bounds to the box enclosing the sphere.
+bool Sphere::computeBounds(AABB& bounds) const
+{
+	const float radius = sqrt(m_radius2);
+	const Vector3D extent(radius, radius, radius);
+	bounds = AABB(m_centre + extent * -1.0f, m_centre + extent);
+	return true;
+}
+
+// Adds a copy of the sphere to the scene store.
+void Sphere::addToScene(Scene& scene) const
+{
+	scene.addSphere(m_centre, m_radius2, m_colour);
 }
@@ -1,12 +1,17 @@
 #pragma once
 #include "Matrix3D.h"
+#include "AABB.h"
+#include "RayPacket.h"
 #include "Image.h"
+#include "Scene.h"
+
+struct RayCounters;
 
 // Base class for all objects in the scene.
 class Object
 {
 public:
-	Object(Point3D centrePoint = Point3D()) : m_centre(centrePoint) {}
+	Object(const Point3D& centrePoint = Point3D()) : m_centre(centrePoint) {}
 	virtual ~Object() {}
 
 	// Returns true if the ray intersects with this object.
@@ -14,16 +19,54 @@ public:
 	//	raySrc					starting point of the ray (input)
 	//	rayDir					direction of the ray (input)
 	//	distToFirstIntersection	distance along the ray from the starting point of the first intersection with the object (output)
-	virtual bool getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection) const = 0;
+	//	counters				the calling thread's ray counters, which the test is added to (input/output)
+	virtual bool getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection, RayCounters& counters) const = 0;
+
+	// Intersects every ray in the packet with this object, updating the closest hit for any ray where this object is closer.
+	// By default this tests each ray in turn; objects with a faster way of testing several rays at once should override it.
+	// The tests are added to counters, which the caller fetches once (e.g. per tile) rather than in every test.
+	virtual void getPacketIntersections(const RayPacket& packet, PacketHits& hits, RayCounters& counters) const;
 
 	// Transforms the object using the given matrix.
 	virtual void applyTransformation(const Matrix3D& matrix) = 0;
-	
-	// The object's RGBA colour
-	Colour	m_colour = Colour(126, 126, 126);
+
+	// Returns the axis-aligned box enclosing the object in world space (empty if the object is unbounded).
+	// The box is cached, and only recomputed on the first query after the object is transformed
+	// (so the first query after a transformation shouldn't be made from several threads at once).
+	const AABB&	getWorldBounds() const;
+
+	// Returns false if the object has infinite extent (e.g. an infinite plane), so no box can enclose it
+	bool		isBounded() const { getWorldBounds(); return m_bounded; }
+
+	// Returns true if the object has finite extent, setting bounds to the axis-aligned box that encloses it.
+	bool		getBounds(AABB& bounds) const { bounds = getWorldBounds(); return m_bounded; }
+
+	// Adds a copy of the object to the arrays for its type in the scene store.
+	virtual void addToScene(Scene& scene) const = 0;
+
+	// Get/set the object's RGBA colour
+	const Colour&	getColour() const { return m_colour; }
+	void			setColour(const Colour& colour) { m_colour = colour; ++m_revision; }
+
+	// Returns a number that changes whenever the object is transformed or its colour changes,
+	// so that cached images of it can tell when they are out of date
+	unsigned	getRevision() const { return m_revision; }
 
 protected:
-	Point3D m_centre;	// The coordinates of the object's centre in world space.
+	// Computes the box enclosing the object, returning false if it has infinite extent.
+	virtual bool computeBounds(AABB& bounds) const = 0;
+
+	// Marks the cached bounds as out of date (called whenever the object moves or changes shape)
+	void	invalidateBounds() { m_boundsValid = false; }
+
+	Point3D		m_centre;							// The coordinates of the object's centre in world space.
+	Colour		m_colour = Colour(126, 126, 126);	// The object's RGBA colour
+	unsigned	m_revision = 0;						// Incremented whenever the object changes
+
+private:
+	mutable AABB	m_bounds;					// Cached result of computeBounds
+	mutable bool	m_bounded = false;
+	mutable bool	m_boundsValid = false;		// Cleared when the cached bounds are out of date
 };
 
 // A plane is a 2D surface defined by its normal and 'centre' point,
@@ -31,14 +74,19 @@ protected:
 class Plane : public Object
 {
 public:
-	Plane(Point3D centrePoint = Point3D(),
-		Vector3D n = Vector3D(0.0f, 1.0f, 0.0f),
-		Vector3D up = Vector3D(0.0f, 0.0f, 1.0f),
+	Plane(const Point3D& centrePoint = Point3D(),
+		const Vector3D& n = Vector3D(0.0f, 1.0f, 0.0f),
+		const Vector3D& up = Vector3D(0.0f, 0.0f, 1.0f),
 		float w = 0.0f, float h = 0.0f);
 	virtual ~Plane() {}
 
-	virtual bool getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection) const;
+	virtual bool getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection, RayCounters& counters) const;
+	virtual void getPacketIntersections(const RayPacket& packet, PacketHits& hits, RayCounters& counters) const;
 	virtual void applyTransformation(const Matrix3D& matrix);
+	virtual void addToScene(Scene& scene) const;
+
+protected:
+	virtual bool computeBounds(AABB& bounds) const;
 
 private:
 	// The plane's orientation is defined by its normal and the directions of its width and height in world space.
@@ -54,11 +102,16 @@ private:
 class Sphere : public Object
 {
 public:
-	Sphere(Point3D centrePoint = Point3D(), float r = 1.0f) : Object(centrePoint), m_radius2(r * r) {}
+	Sphere(const Point3D& centrePoint = Point3D(), float r = 1.0f) : Object(centrePoint), m_radius2(r * r) {}
 	virtual ~Sphere() {}
 
-	virtual bool getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection) const;
+	virtual bool getIntersection(const Point3D& raySrc, const Vector3D& rayDir, float& distToFirstIntersection, RayCounters& counters) const;
+	virtual void getPacketIntersections(const RayPacket& packet, PacketHits& hits, RayCounters& counters) const;
 	virtual void applyTransformation(const Matrix3D& matrix);
+	virtual void addToScene(Scene& scene) const;
+
+protected:
+	virtual bool computeBounds(AABB& bounds) const;
 
 private:
 	float	m_radius2;	// The squared radius of the sphere
@@ -2,6 +2,7 @@
 #include "Vector3D.h"
 
 // A class for performing basic operations with homogeneous points in 3D space.
+// Like Vector3D, the components are stored together (but not over-aligned) so that they can be operated on with SSE.
 // Feel free to edit/extend!
 class Point3D
 {
@@ -20,12 +21,16 @@ public:
 	// Returns the point at the given vector displacement from this point
 	Point3D operator+(const Vector3D& vec) const
 	{
-		return Point3D(x + vec.x, y + vec.y, z + vec.z);
+		Point3D result;
+		VectorMath::store(&result.x, _mm_add_ps(VectorMath::load(&x), VectorMath::load(&vec.x)));
+		return result;
 	}
 
 	// Returns the vector difference between two points
 	Vector3D operator-(const Point3D& other) const
 	{
-		return Vector3D(x - other.x, y - other.y, z - other.z);
+		Vector3D result;
+		VectorMath::store(&result.x, _mm_sub_ps(VectorMath::load(&x), VectorMath::load(&other.x)));
+		return result;
 	}
 };
\ No newline at end of file
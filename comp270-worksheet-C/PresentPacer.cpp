@@ -0,0 +1,76 @@
+#include "stdafx.h"
+#include "PresentPacer.h"
+#include "Profiler.h"
+
+static const double	c_smoothing = 0.1;		// Weight of each new present in the smoothed averages
+static const double	c_spinMs = 2.0;			// Time before a fixed rate present at which to stop sleeping and spin instead
+
+void PresentPacer::setMode(Mode mode, double targetRate)
+{
+	m_mode = mode;
+	m_targetRate = max(1.0, targetRate);
+	m_scheduled = false;
+}
+
+const char* PresentPacer::getModeName() const
+{
+	switch (m_mode)
+	{
+	case Mode::VSync:
+		return "vsync";
+	case Mode::Uncapped:
+		return "uncapped";
+	case Mode::FixedRate:
+		return "fixed rate";
+	}
+	return "";
+}
+
+// Waits until the next present is due in FixedRate mode. Presents are spaced a whole period apart; if one is late by
+// more than a period (e.g. because no frame was ready), the schedule restarts from now rather than presenting a burst to catch up.
+void PresentPacer::waitForNextPresent()
+{
+	if (m_mode != Mode::FixedRate)
+		return;
+
+	PROFILE_ZONE("Pacing");
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetRate));
+	Clock::time_point now = Clock::now();
+	if (!m_scheduled || now - m_nextPresent > period)
+	{
+		m_nextPresent = now;
+		m_scheduled = true;
+	}
+
+	// Sleep until shortly before the present is due, then spin for the rest
+	const Clock::duration spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(c_spinMs));
+	if (m_nextPresent - now > spin)
+		std::this_thread::sleep_for(m_nextPresent - now - spin);
+	while (Clock::now() < m_nextPresent)
+		std::this_thread::yield();
+
+	m_nextPresent += period;
+}
+
+void PresentPacer::addPresent(double presentMs, double latencyMs)
+{
+	m_averagePresentMs = m_presents == 0 ? presentMs : m_averagePresentMs + c_smoothing * (presentMs - m_averagePresentMs);
+	m_maxPresentMs = max(m_maxPresentMs, presentMs);
+	++m_presents;
+
+	if (latencyMs >= 0.0)
+	{
+		m_averageLatencyMs = m_latencies == 0 ? latencyMs : m_averageLatencyMs + c_smoothing * (latencyMs - m_averageLatencyMs);
+		m_maxLatencyMs = max(m_maxLatencyMs, latencyMs);
+		++m_latencies;
+	}
+}
+
+void PresentPacer::writeJson(std::ostream& out) const
+{
+	out << "{ \"mode\": \"" << getModeName() << "\"";
+	if (m_mode == Mode::FixedRate)
+		out << ", \"target_rate\": " << m_targetRate;
+	out << ", \"presents\": " << m_presents << ", \"average_present_ms\": " << m_averagePresentMs << ", \"max_present_ms\": " << m_maxPresentMs
+		<< ", \"average_latency_ms\": " << m_averageLatencyMs << ", \"max_latency_ms\": " << m_maxLatencyMs << " }";
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+// Decides when each frame is presented, and measures what presenting costs.
+// In VSync mode the renderer waits for the display's refresh inside SDL_RenderPresent; in Uncapped mode frames are
+// presented as soon as they are drawn; in FixedRate mode waitForNextPresent holds each present back until its slot at
+// the target rate, sleeping for most of the wait and spinning for the last part (as a sleep can overshoot by a millisecond or more).
+class PresentPacer
+{
+public:
+	enum class Mode
+	{
+		VSync,
+		Uncapped,
+		FixedRate
+	};
+
+	// Set the pacing mode, and the number of presents per second in FixedRate mode
+	void		setMode(Mode mode, double targetRate = 60.0);
+	Mode		getMode() const { return m_mode; }
+	double		getTargetRate() const { return m_targetRate; }
+	const char*	getModeName() const;
+
+	// Whether the renderer should be created with SDL_RENDERER_PRESENTVSYNC
+	bool		usesVSync() const { return m_mode == Mode::VSync; }
+
+	// Wait until the next frame should be presented (returns immediately unless the mode is FixedRate)
+	void		waitForNextPresent();
+
+	// Record a present.
+	// Params:
+	//	presentMs	Time spent in SDL_RenderPresent
+	//	latencyMs	Time from the frame being finished by the render thread to the present returning (negative if the
+	//				present only redrew a frame that had already been shown)
+	void		addPresent(double presentMs, double latencyMs);
+
+	// Smoothed times of recent presents, in milliseconds
+	double		getAveragePresentMs() const { return m_averagePresentMs; }
+	double		getAverageLatencyMs() const { return m_averageLatencyMs; }
+
+	// Writes the mode and the present timings as a JSON object
+	void		writeJson(std::ostream& out) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	Mode				m_mode = Mode::VSync;
+	double				m_targetRate = 60.0;		// Presents per second in FixedRate mode
+	Clock::time_point	m_nextPresent;				// When the next present is due in FixedRate mode
+	bool				m_scheduled = false;		// Set once m_nextPresent has been set
+
+	unsigned			m_presents = 0;
+	double				m_averagePresentMs = 0.0;
+	double				m_maxPresentMs = 0.0;
+	unsigned			m_latencies = 0;
+	double				m_averageLatencyMs = 0.0;
+	double				m_maxLatencyMs = 0.0;
+};
\ No newline at end of file
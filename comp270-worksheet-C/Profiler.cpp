@@ -0,0 +1,124 @@
+#include "stdafx.h"
+#include "Profiler.h"
+#include <climits>
+#include <iomanip>
+
+namespace
+{
+	// Number of zones each thread keeps (older ones are overwritten)
+	const unsigned c_eventsPerThread = 1 << 16;
+
+	struct Event
+	{
+		const char*	name;
+		long long	startNs;
+		long long	endNs;
+	};
+
+	// The zones recorded by one thread
+	struct ThreadBuffer
+	{
+		unsigned				threadIdx = 0;		// Order in which the thread recorded its first zone (used as its id in the trace)
+		std::string				name;
+		std::vector<Event>		events;				// Ring buffer of c_eventsPerThread zones
+		std::atomic<unsigned>	count{ 0 };			// Total number of zones recorded (the next one goes in events[count % c_eventsPerThread])
+	};
+
+	// Every thread's buffer, kept until the program exits (so threads that have finished still appear in the trace)
+	std::mutex									s_buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>>	s_buffers;
+
+	// Returns the calling thread's buffer, creating it the first time
+	ThreadBuffer& getThreadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			std::unique_ptr<ThreadBuffer> newBuffer(new ThreadBuffer());
+			newBuffer->events.resize(c_eventsPerThread);
+
+			std::lock_guard<std::mutex> lock(s_buffersMutex);
+			newBuffer->threadIdx = (unsigned)s_buffers.size();
+			buffer = newBuffer.get();
+			s_buffers.push_back(std::move(newBuffer));
+		}
+		return *buffer;
+	}
+
+	// Writes a string to the trace, escaping characters that are special in JSON
+	void writeJsonString(std::ostream& out, const char* str)
+	{
+		out << '"';
+		for (; *str != '\0'; ++str)
+		{
+			if (*str == '"' || *str == '\\')
+				out << '\\';
+			out << *str;
+		}
+		out << '"';
+	}
+}
+
+// Adds a zone to the calling thread's ring buffer, overwriting the oldest one if it is full
+void Profiler::record(const char* name, long long startNs, long long endNs)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+	const unsigned count = buffer.count.load(std::memory_order_relaxed);
+	buffer.events[count % c_eventsPerThread] = { name, startNs, endNs };
+	buffer.count.store(count + 1, std::memory_order_release);
+}
+
+void Profiler::setThreadName(const char* name)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock(s_buffersMutex);
+	buffer.name = name;
+}
+
+// Writes the recorded zones as complete ("X") events, with times in microseconds from the earliest zone,
+// plus a metadata event naming each thread
+bool Profiler::writeChromeTrace(const char* path)
+{
+	std::ofstream file(path);
+	if (!file)
+		return false;
+
+	std::lock_guard<std::mutex> lock(s_buffersMutex);
+
+	// Find the range of events still held by each buffer, and the earliest time
+	long long firstNs = LLONG_MAX;
+	for (auto& buffer : s_buffers)
+	{
+		const unsigned count = buffer->count.load(std::memory_order_acquire);
+		for (unsigned eventIdx = count > c_eventsPerThread ? count - c_eventsPerThread : 0; eventIdx < count; ++eventIdx)
+			firstNs = min(firstNs, buffer->events[eventIdx % c_eventsPerThread].startNs);
+	}
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[" << std::endl;
+	bool first = true;
+	for (auto& buffer : s_buffers)
+	{
+		if (!buffer->name.empty())
+		{
+			file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadIdx << ",\"args\":{\"name\":";
+			writeJsonString(file, buffer->name.c_str());
+			file << "}}";
+			first = false;
+		}
+
+		const unsigned count = buffer->count.load(std::memory_order_acquire);
+		for (unsigned eventIdx = count > c_eventsPerThread ? count - c_eventsPerThread : 0; eventIdx < count; ++eventIdx)
+		{
+			const Event& event = buffer->events[eventIdx % c_eventsPerThread];
+			file << (first ? "" : ",\n") << "{\"name\":";
+			writeJsonString(file, event.name);
+			file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadIdx
+				<< ",\"ts\":" << (event.startNs - firstNs) / 1000.0 << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << "}";
+			first = false;
+		}
+	}
+	file << std::endl << "]}" << std::endl;
+
+	return (bool)file;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+// Records how long named zones of code take on each thread, for viewing as a timeline in a trace viewer
+// (chrome://tracing or ui.perfetto.dev).
+// Zones are marked with PROFILE_ZONE("name"), which times the rest of the enclosing scope. They are only recorded when
+// the project is built with ENABLE_PROFILER defined; otherwise the macros compile to nothing, so they cost nothing.
+// Each thread records into its own fixed-size ring buffer (keeping the most recent zones), so recording never locks
+// or allocates after a thread's first zone.
+namespace Profiler
+{
+#ifdef ENABLE_PROFILER
+	const bool c_enabled = true;
+#else
+	const bool c_enabled = false;
+#endif
+
+	// Returns the current time, in nanoseconds since an arbitrary point
+	inline long long now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Adds a zone to the calling thread's buffer (name must be a string literal, or otherwise outlive the profiler)
+	void	record(const char* name, long long startNs, long long endNs);
+
+	// Names the calling thread in the exported trace
+	void	setThreadName(const char* name);
+
+	// Writes every zone still held in the buffers to a file in the Chrome trace event format.
+	// The threads being profiled should be idle while this runs (e.g. between frames).
+	bool	writeChromeTrace(const char* path);
+
+	// Times the scope it is declared in
+	class Zone
+	{
+	public:
+		explicit Zone(const char* name) : m_name(name), m_startNs(now()) {}
+		~Zone() { record(m_name, m_startNs, now()); }
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char*	m_name;
+		long long	m_startNs;
+	};
+}
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
\ No newline at end of file
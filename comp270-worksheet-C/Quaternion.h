@@ -0,0 +1,62 @@
+#pragma once
+#include "Vector3D.h"
+
+// A unit quaternion representing an orientation in 3D space.
+// Unlike Euler angles, repeatedly applying small rotations never locks two axes together, and getting the
+// rotated axes needs no trigonometry (only building a rotation about an axis does).
+class Quaternion
+{
+public:
+	Quaternion(float w_ = 1.0f, float x_ = 0.0f, float y_ = 0.0f, float z_ = 0.0f) : w(w_), x(x_), y(y_), z(z_) {}
+
+	// Returns the rotation by angle radians about the given unit axis
+	static Quaternion fromAxisAngle(const Vector3D& axis, float angle)
+	{
+		const float s = sinf(0.5f * angle);
+		return Quaternion(cosf(0.5f * angle), axis.x * s, axis.y * s, axis.z * s);
+	}
+
+	// Components of the quaternion (w is the scalar part)
+	float w, x, y, z;
+
+	bool operator==(const Quaternion& other) const { return w == other.w && x == other.x && y == other.y && z == other.z; }
+	bool operator!=(const Quaternion& other) const { return !(*this == other); }
+
+	// Returns the rotation that applies the right rotation, then this one
+	Quaternion operator*(const Quaternion& right) const
+	{
+		return Quaternion(w * right.w - x * right.x - y * right.y - z * right.z,
+						  w * right.x + x * right.w + y * right.z - z * right.y,
+						  w * right.y - x * right.z + y * right.w + z * right.x,
+						  w * right.z + x * right.y - y * right.x + z * right.w);
+	}
+
+	// Scale the quaternion back to unit length
+	void normalise()
+	{
+		const float scale = 1.0f / sqrtf(w * w + x * x + y * y + z * z);
+		w *= scale;
+		x *= scale;
+		y *= scale;
+		z *= scale;
+	}
+
+	// Rotate by angle radians about one of this orientation's own axes (e.g. (0, 1, 0) turns about the rotated y-axis).
+	// The result is renormalised, so that rounding errors don't build up over many small rotations.
+	void rotate(const Vector3D& localAxis, float angle)
+	{
+		*this = *this * fromAxisAngle(localAxis, angle);
+		normalise();
+	}
+
+	// Get the world space directions of the rotated x, y and z axes (the columns of the equivalent rotation matrix)
+	void getAxes(Vector3D& xAxis, Vector3D& yAxis, Vector3D& zAxis) const
+	{
+		const float xx = x * x, yy = y * y, zz = z * z;
+		const float xy = x * y, xz = x * z, yz = y * z;
+		const float wx = w * x, wy = w * y, wz = w * z;
+		xAxis = Vector3D(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy));
+		yAxis = Vector3D(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx));
+		zAxis = Vector3D(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy));
+	}
+};
\ No newline at end of file
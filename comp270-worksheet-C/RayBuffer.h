@@ -0,0 +1,49 @@
+#pragma once
+#include "Vector3D.h"
+#include "AlignedArray.h"
+
+// Directions of a set of rays, stored as separate x, y and z arrays in one aligned block of memory,
+// so that the directions of consecutive rays can be loaded straight into SIMD registers.
+class RayBuffer
+{
+public:
+	// Number of floats each array is padded to a multiple of (so each array starts on a 64-byte boundary)
+	static const unsigned c_padding = 16;
+
+	// Change the number of rays, reusing the existing memory where possible
+	void resize(unsigned count)
+	{
+		m_count = count;
+		m_stride = (count + c_padding - 1) / c_padding * c_padding;
+		m_data.resize(3 * m_stride);
+	}
+
+	unsigned	size() const { return m_count; }
+	bool		empty() const { return m_count == 0; }
+
+	// Access the arrays of each component of the directions
+	float*			x() { return m_data.data(); }
+	float*			y() { return m_data.data() + m_stride; }
+	float*			z() { return m_data.data() + 2 * m_stride; }
+	const float*	x() const { return m_data.data(); }
+	const float*	y() const { return m_data.data() + m_stride; }
+	const float*	z() const { return m_data.data() + 2 * m_stride; }
+
+	// Get/set the direction of a single ray
+	Vector3D getDirection(unsigned idx) const
+	{
+		return Vector3D(x()[idx], y()[idx], z()[idx]);
+	}
+
+	void setDirection(unsigned idx, const Vector3D& dir)
+	{
+		x()[idx] = dir.x;
+		y()[idx] = dir.y;
+		z()[idx] = dir.z;
+	}
+
+private:
+	AlignedArray<float>	m_data;
+	unsigned			m_count = 0;	// Number of rays
+	unsigned			m_stride = 0;	// Distance between the start of each component array
+};
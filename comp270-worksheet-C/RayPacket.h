@@ -0,0 +1,42 @@
+#pragma once
+#include "Point3D.h"
+
+class Object;
+
+// A group of rays that share a starting point (e.g. primary rays through neighbouring pixels),
+// with their directions stored as separate x, y and z arrays so that they can be intersected with an object together.
+struct RayPacket
+{
+	static const unsigned c_maxSize = 16;
+
+	Point3D		origin;			// Starting point of every ray in the packet
+	unsigned	count = 0;		// Number of rays in the packet
+
+	// Directions of the rays. Entries from count up to c_maxSize must be zero (so they never hit anything).
+	alignas(64) float	dirX[c_maxSize];
+	alignas(64) float	dirY[c_maxSize];
+	alignas(64) float	dirZ[c_maxSize];
+
+	// Zero the directions of the unused rays
+	void padDirections()
+	{
+		for (unsigned idx = count; idx < c_maxSize; ++idx)
+			dirX[idx] = dirY[idx] = dirZ[idx] = 0.0f;
+	}
+};
+
+// The closest intersection found so far for each ray in a packet
+struct PacketHits
+{
+	alignas(64) float	distance[RayPacket::c_maxSize];		// Distance along the ray to the closest intersection
+	const Object*		object[RayPacket::c_maxSize];		// The object intersected (or null if none)
+
+	PacketHits()
+	{
+		for (unsigned idx = 0; idx < RayPacket::c_maxSize; ++idx)
+		{
+			distance[idx] = FLT_MAX;
+			object[idx] = nullptr;
+		}
+	}
+};
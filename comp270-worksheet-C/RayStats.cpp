@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include "RayStats.h"
+
+RayCounters& RayCounters::operator+=(const RayCounters& other)
+{
+	primaryRays += other.primaryRays;
+	sphereTests += other.sphereTests;
+	planeTests += other.planeTests;
+	boxTests += other.boxTests;
+	hits += other.hits;
+	misses += other.misses;
+	return *this;
+}
+
+RayCounters RayCounters::operator-(const RayCounters& other) const
+{
+	RayCounters difference;
+	difference.primaryRays = primaryRays - other.primaryRays;
+	difference.sphereTests = sphereTests - other.sphereTests;
+	difference.planeTests = planeTests - other.planeTests;
+	difference.boxTests = boxTests - other.boxTests;
+	difference.hits = hits - other.hits;
+	difference.misses = misses - other.misses;
+	return difference;
+}
+
+void RayCounters::writeJson(std::ostream& out) const
+{
+	out << "{ \"primary_rays\": " << primaryRays << ", \"sphere_tests\": " << sphereTests << ", \"plane_tests\": " << planeTests
+		<< ", \"box_tests\": " << boxTests << ", \"hits\": " << hits << ", \"misses\": " << misses
+		<< ", \"tests_per_ray\": " << getTestsPerRay() << " }";
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+namespace
+{
+	// Every thread's counters, kept until the program exits (so the counts from threads that have finished aren't lost).
+	// Each set is followed by a cache line of padding, so that threads don't slow each other down by writing to the same line.
+	struct ThreadCounters
+	{
+		RayCounters	counters;
+		char		padding[64];
+	};
+
+	std::mutex										s_threadsMutex;
+	std::vector<std::unique_ptr<ThreadCounters>>	s_threads;
+}
+
+// Creates the counters for the calling thread (called the first time it counts anything)
+RayCounters* RayStats::registerThread()
+{
+	std::unique_ptr<ThreadCounters> thread(new ThreadCounters());
+	RayCounters* counters = &thread->counters;
+
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	s_threads.push_back(std::move(thread));
+	return counters;
+}
+
+RayCounters RayStats::getTotals()
+{
+	RayCounters totals;
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	for (auto& thread : s_threads)
+		totals += thread->counters;
+	return totals;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+// Counts of the work done finding the objects hit by rays, for judging how well the acceleration structures are working
+struct RayCounters
+{
+	unsigned long long	primaryRays = 0;	// Rays cast from the camera
+	unsigned long long	sphereTests = 0;	// Ray-sphere intersection tests
+	unsigned long long	planeTests = 0;		// Ray-plane intersection tests
+	unsigned long long	boxTests = 0;		// Ray-bounding box tests made while traversing the BVH
+	unsigned long long	hits = 0;			// Primary rays that hit an object
+	unsigned long long	misses = 0;			// Primary rays that hit nothing
+
+	unsigned long long	getPrimitiveTests() const { return sphereTests + planeTests; }
+
+	// Returns the average number of intersection tests (with primitives and with bounding boxes) made per primary ray
+	double	getTestsPerRay() const { return primaryRays > 0 ? (double)(getPrimitiveTests() + boxTests) / primaryRays : 0.0; }
+
+	RayCounters&	operator+=(const RayCounters& other);
+	RayCounters		operator-(const RayCounters& other) const;
+
+	// Writes the counters as a JSON object
+	void	writeJson(std::ostream& out) const;
+};
+
+// Ray counters accumulated separately by each thread, so that counting never contends between threads.
+// The totals are found by summing every thread's counters, which should be done while the tracing threads are idle.
+namespace RayStats
+{
+	RayCounters*	registerThread();
+
+	// Returns the calling thread's counters. Finding them is a thread-local lookup, so the tracing code fetches them
+	// once per tile and passes them down to the intersection tests.
+	inline RayCounters& local()
+	{
+		thread_local RayCounters* counters = nullptr;
+		if (counters == nullptr)
+			counters = registerThread();
+		return *counters;
+	}
+
+	// Returns the sum of every thread's counters since the program started
+	RayCounters		getTotals();
+}
\ No newline at end of file
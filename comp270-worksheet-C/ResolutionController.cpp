@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "ResolutionController.h"
+
+// The scale is lowered when the smoothed frame time goes above c_lowerAbove times the target, and raised when it goes
+// below c_raiseBelow times the target; in between it is left alone. Changes aim for c_aimFor times the target.
+static const double	c_lowerAbove = 1.1;
+static const double	c_raiseBelow = 0.75;
+static const double	c_aimFor = 0.9;
+
+static const double		c_smoothing = 0.25;		// Weight of each new frame time in the smoothed average
+static const unsigned	c_settleFrames = 3;		// Number of frames that trace rays to measure before changing the scale (no more than
+												// the camera's refinement passes, so that a view that stops moving still gets measured)
+static const float		c_minScale = 0.25f;		// Lowest fraction of the base resolution to render at
+static const float		c_maxIncrease = 1.25f;	// Largest factor the scale can grow by in one change (it can shrink by any amount)
+static const float		c_scaleSteps = 32.0f;	// The scale is a multiple of 1 / c_scaleSteps, so small changes in frame time are ignored
+
+// Sets the highest resolution to render at, i.e. the resolution when the scale is 1
+void ResolutionController::setBaseResolution(unsigned resolutionX, unsigned resolutionY)
+{
+	m_baseResolutionX = max(1u, resolutionX);
+	m_baseResolutionY = max(1u, resolutionY);
+	m_framesMeasured = 0;
+}
+
+// Enables or disables the controller, starting again from the base resolution
+void ResolutionController::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+	setScale(1.0f);
+}
+
+// Records the time taken to render a frame, and decides whether the scale should change.
+// Returns true if it has changed, so the caller should switch to the new resolution.
+// Params:
+//	frameMs		Time taken to render the frame at the current resolution
+//	traceMs		Part of frameMs spent tracing rays (the rest, such as shading and refitting the BVH, doesn't depend on the rays cast)
+//	raysCast	Number of rays the frame traced (fewer than the number of pixels during progressive refinement,
+//				in which case the trace time is scaled up to estimate the cost of tracing every pixel; zero if nothing was traced)
+bool ResolutionController::addFrame(double frameMs, double traceMs, unsigned raysCast)
+{
+	// A frame that reused the previous image says nothing about the cost of rendering, so only frames that trace are counted
+	if (!m_enabled || raysCast == 0)
+		return false;
+
+	const double traceScale = max(1.0, (double)getResolutionX() * getResolutionY() / raysCast);
+	const double fullFrameMs = frameMs + traceMs * (traceScale - 1.0);
+	m_averageMs = m_framesMeasured > 0 ? m_averageMs + c_smoothing * (fullFrameMs - m_averageMs) : fullFrameMs;
+	if (++m_framesMeasured < c_settleFrames)
+		return false;
+
+	// The time taken is roughly proportional to the number of pixels, i.e. to the square of the scale
+	const double ratio = m_targetMs * c_aimFor / max(m_averageMs, 0.001);
+	float scale = m_scale;
+	if (m_averageMs > m_targetMs * c_lowerAbove)
+		scale = max(c_minScale, floorf(m_scale * (float)sqrt(ratio) * c_scaleSteps) / c_scaleSteps);
+	else if (m_averageMs < m_targetMs * c_raiseBelow && m_scale < 1.0f)
+		scale = min(1.0f, ceilf(m_scale * min(c_maxIncrease, (float)sqrt(ratio)) * c_scaleSteps) / c_scaleSteps);
+
+	if (scale == m_scale)
+		return false;
+
+	setScale(scale);
+	return true;
+}
+
+// Returns the given resolution multiplied by the scale
+unsigned ResolutionController::getScaledResolution(unsigned baseResolution) const
+{
+	return max(1u, (unsigned)(baseResolution * getScale() + 0.5f));
+}
+
+// Changes the scale, discarding the frame times measured at the old one
+void ResolutionController::setScale(float scale)
+{
+	m_scale = scale;
+	m_averageMs = 0.0;
+	m_framesMeasured = 0;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+// Chooses the resolution to render at so that frames take close to a target time.
+// The resolution is a fraction (the scale) of a base resolution in each direction. Frame times are smoothed, and the
+// scale only changes when they stay outside a band around the target for a few frames, so it doesn't flip back and forth.
+class ResolutionController
+{
+public:
+	// Set the highest resolution to render at (the resolution when the scale is 1)
+	void		setBaseResolution(unsigned resolutionX, unsigned resolutionY);
+	unsigned	getBaseResolutionX() const { return m_baseResolutionX; }
+	unsigned	getBaseResolutionY() const { return m_baseResolutionY; }
+
+	// Set the time that each frame should take, in milliseconds
+	void		setTargetFrameMs(double targetMs) { m_targetMs = max(0.1, targetMs); }
+	double		getTargetFrameMs() const { return m_targetMs; }
+
+	// Enable or disable the controller; when it is disabled the base resolution is used
+	void		setEnabled(bool enabled);
+	bool		isEnabled() const { return m_enabled; }
+
+	// Record the time taken to render a frame at the current resolution, the part of it spent tracing rays, and the number
+	// of rays it traced. Frames that trace no rays are ignored. Returns true if the resolution should change.
+	bool		addFrame(double frameMs, double traceMs, unsigned raysCast);
+
+	// The resolution to render at
+	unsigned	getResolutionX() const { return getScaledResolution(m_baseResolutionX); }
+	unsigned	getResolutionY() const { return getScaledResolution(m_baseResolutionY); }
+	float		getScale() const { return m_enabled ? m_scale : 1.0f; }
+
+private:
+	unsigned	getScaledResolution(unsigned baseResolution) const;
+	void		setScale(float scale);
+
+	unsigned	m_baseResolutionX = 250, m_baseResolutionY = 250;
+	double		m_targetMs = 16.6;			// Time each frame should take
+	bool		m_enabled = false;
+
+	float		m_scale = 1.0f;				// Fraction of the base resolution to render at, in each direction
+	double		m_averageMs = 0.0;			// Smoothed estimate of the time to trace every pixel at the current scale
+	unsigned	m_framesMeasured = 0;		// Number of frames that traced rays added since the scale last changed
+};
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "stdafx.h"
+#include "Scene.h"
+#include "Object.h"
+#include "RayStats.h"
+
+// Removes every primitive from the store (keeping the storage for reuse)
+void Scene::clear()
+{
+	m_sphereX.clear(); m_sphereY.clear(); m_sphereZ.clear();
+	m_sphereRadius2.clear();
+	m_sphereColours.clear();
+
+	m_planeX.clear(); m_planeY.clear(); m_planeZ.clear();
+	m_planeNormalX.clear(); m_planeNormalY.clear(); m_planeNormalZ.clear();
+	m_planeWDirX.clear(); m_planeWDirY.clear(); m_planeWDirZ.clear();
+	m_planeHDirX.clear(); m_planeHDirY.clear(); m_planeHDirZ.clear();
+	m_planeHalfWidth.clear(); m_planeHalfHeight.clear();
+	m_planeColours.clear();
+	updateArrays();
+	++m_revision;
+}
+
+// Copies each of the given objects into the arrays for its type
+void Scene::addObjects(const std::vector<Object*>& objects)
+{
+	for (auto obj : objects)
+		obj->addToScene(*this);
+}
+
+// Creates an object for each primitive in the store, adding them to the list (which takes ownership of them)
+void Scene::createObjects(std::vector<Object*>& objects) const
+{
+	objects.reserve(objects.size() + numSpheres() + numPlanes());
+	for (unsigned idx = 0; idx < m_planes.count; ++idx)
+	{
+		const PlaneArrays& p = m_planes;
+		Object* plane = new Plane(Point3D(p.x[idx], p.y[idx], p.z[idx]), Vector3D(p.normalX[idx], p.normalY[idx], p.normalZ[idx]),
+								  Vector3D(p.hDirX[idx], p.hDirY[idx], p.hDirZ[idx]), 2.0f * p.halfWidth[idx], 2.0f * p.halfHeight[idx]);
+		plane->setColour(p.colours[idx]);
+		objects.push_back(plane);
+	}
+	for (unsigned idx = 0; idx < m_spheres.count; ++idx)
+	{
+		Object* sphere = new Sphere(Point3D(m_spheres.x[idx], m_spheres.y[idx], m_spheres.z[idx]), sqrtf(m_spheres.radius2[idx]));
+		sphere->setColour(m_spheres.colours[idx]);
+		objects.push_back(sphere);
+	}
+}
+
+// Adds a sphere to the store.
+// Params:
+//	centre		the sphere's centre (in world space)
+//	radius2		the square of the sphere's radius
+//	colour		the sphere's colour
+void Scene::addSphere(const Point3D& centre, float radius2, const Colour& colour)
+{
+	m_sphereX.push_back(centre.x);
+	m_sphereY.push_back(centre.y);
+	m_sphereZ.push_back(centre.z);
+	m_sphereRadius2.push_back(radius2);
+	m_sphereColours.push_back(colour);
+	updateArrays();
+	++m_revision;
+}
+
+// Adds a plane to the store.
+// Params:
+//	centre					the point on the plane from which the width and height limits are measured (in world space)
+//	normal, wDir, hDir		the plane's normal and the directions of its width and height (in world space)
+//	halfWidth, halfHeight	half the plane's width and height (zero or less for an infinite plane)
+//	colour					the plane's colour
+void Scene::addPlane(const Point3D& centre, const Vector3D& normal, const Vector3D& wDir, const Vector3D& hDir,
+					 float halfWidth, float halfHeight, const Colour& colour)
+{
+	m_planeX.push_back(centre.x);
+	m_planeY.push_back(centre.y);
+	m_planeZ.push_back(centre.z);
+	m_planeNormalX.push_back(normal.x);
+	m_planeNormalY.push_back(normal.y);
+	m_planeNormalZ.push_back(normal.z);
+	m_planeWDirX.push_back(wDir.x);
+	m_planeWDirY.push_back(wDir.y);
+	m_planeWDirZ.push_back(wDir.z);
+	m_planeHDirX.push_back(hDir.x);
+	m_planeHDirY.push_back(hDir.y);
+	m_planeHDirZ.push_back(hDir.z);
+	m_planeHalfWidth.push_back(halfWidth);
+	m_planeHalfHeight.push_back(halfHeight);
+	m_planeColours.push_back(colour);
+	updateArrays();
+	++m_revision;
+}
+
+// Replaces the contents of the store with arrays stored elsewhere, which are traced without being copied
+void Scene::attach(const SphereArrays& spheres, const PlaneArrays& planes)
+{
+	clear();
+	m_spheres = spheres;
+	m_planes = planes;
+	++m_revision;
+}
+
+// Points the traced arrays at the store's own storage (which may have moved as it grew)
+void Scene::updateArrays()
+{
+	m_spheres.count = (unsigned)m_sphereRadius2.size();
+	m_spheres.x = m_sphereX.data();
+	m_spheres.y = m_sphereY.data();
+	m_spheres.z = m_sphereZ.data();
+	m_spheres.radius2 = m_sphereRadius2.data();
+	m_spheres.colours = m_sphereColours.data();
+
+	m_planes.count = (unsigned)m_planeHalfWidth.size();
+	m_planes.x = m_planeX.data();
+	m_planes.y = m_planeY.data();
+	m_planes.z = m_planeZ.data();
+	m_planes.normalX = m_planeNormalX.data();
+	m_planes.normalY = m_planeNormalY.data();
+	m_planes.normalZ = m_planeNormalZ.data();
+	m_planes.wDirX = m_planeWDirX.data();
+	m_planes.wDirY = m_planeWDirY.data();
+	m_planes.wDirZ = m_planeWDirZ.data();
+	m_planes.hDirX = m_planeHDirX.data();
+	m_planes.hDirY = m_planeHDirY.data();
+	m_planes.hDirZ = m_planeHDirZ.data();
+	m_planes.halfWidth = m_planeHalfWidth.data();
+	m_planes.halfHeight = m_planeHalfHeight.data();
+	m_planes.colours = m_planeColours.data();
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Finds the closest primitive to the ray source that is intersected by the ray, updating hit if it is closer.
+// Params:
+//	raySrc		starting point of the ray (input)
+//	rayDir		direction of the ray (input)
+//	hit			closest intersection so far, replaced if a closer one is found (input/output)
+//	counters	the calling thread's ray counters, which the tests are added to (input/output)
+void Scene::getClosestIntersection(const Point3D& raySrc, const Vector3D& rayDir, Hit& hit, RayCounters& counters) const
+{
+	counters.sphereTests += m_spheres.count;
+	counters.planeTests += m_planes.count;
+
+	getClosestSphere(raySrc, rayDir, hit);
+	getClosestPlane(raySrc, rayDir, hit);
+}
+
+// Returns the colour of the primitive that was hit
+const Colour& Scene::getColour(const Hit& hit) const
+{
+	return hit.type == PrimitiveType::Sphere ? m_spheres.colours[hit.index] : m_planes.colours[hit.index];
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Tests the ray against every sphere, using the same calculation as Sphere::getIntersection.
+// The loop has no data-dependent branches (results are selected rather than branched on), so the compiler can vectorise it.
+void Scene::getClosestSphere(const Point3D& raySrc, const Vector3D& rayDir, Hit& hit) const
+{
+	const float* centreX = m_spheres.x;
+	const float* centreY = m_spheres.y;
+	const float* centreZ = m_spheres.z;
+	const float* radius2 = m_spheres.radius2;
+
+	float nearestDist = hit.distance;
+	int nearestIdx = -1;
+	const unsigned count = m_spheres.count;
+	for (unsigned idx = 0; idx < count; ++idx)
+	{
+		const float srcToCentreX = centreX[idx] - raySrc.x;
+		const float srcToCentreY = centreY[idx] - raySrc.y;
+		const float srcToCentreZ = centreZ[idx] - raySrc.z;
+		const float tc = srcToCentreX * rayDir.x + srcToCentreY * rayDir.y + srcToCentreZ * rayDir.z;
+		const float distSq = (srcToCentreX * srcToCentreX + srcToCentreY * srcToCentreY + srcToCentreZ * srcToCentreZ) - tc * tc;
+		const float dist = tc - sqrtf(fmaxf(radius2[idx] - distSq, 0.0f));
+
+		const bool closer = (tc > 0.0f) & (distSq < radius2[idx]) & (dist < nearestDist);
+		nearestDist = closer ? dist : nearestDist;
+		nearestIdx = closer ? (int)idx : nearestIdx;
+	}
+
+	if (nearestIdx >= 0)
+	{
+		hit.type = PrimitiveType::Sphere;
+		hit.index = (unsigned)nearestIdx;
+		hit.distance = nearestDist;
+	}
+}
+
+// Tests the ray against every plane, using the same calculation as Plane::getIntersection.
+// Like getClosestSphere, the loop has no data-dependent branches, so the compiler can vectorise it.
+void Scene::getClosestPlane(const Point3D& raySrc, const Vector3D& rayDir, Hit& hit) const
+{
+	const PlaneArrays& p = m_planes;
+
+	float nearestDist = hit.distance;
+	int nearestIdx = -1;
+	const unsigned count = p.count;
+	for (unsigned idx = 0; idx < count; ++idx)
+	{
+		const float srcToCentreX = p.x[idx] - raySrc.x;
+		const float srcToCentreY = p.y[idx] - raySrc.y;
+		const float srcToCentreZ = p.z[idx] - raySrc.z;
+		const float denom = rayDir.x * p.normalX[idx] + rayDir.y * p.normalY[idx] + rayDir.z * p.normalZ[idx];
+		const float dist = (srcToCentreX * p.normalX[idx] + srcToCentreY * p.normalY[idx] + srcToCentreZ * p.normalZ[idx]) / denom;
+		const float u = dist * (rayDir.x * p.wDirX[idx] + rayDir.y * p.wDirY[idx] + rayDir.z * p.wDirZ[idx])
+			- (srcToCentreX * p.wDirX[idx] + srcToCentreY * p.wDirY[idx] + srcToCentreZ * p.wDirZ[idx]);
+		const float v = dist * (rayDir.x * p.hDirX[idx] + rayDir.y * p.hDirY[idx] + rayDir.z * p.hDirZ[idx])
+			- (srcToCentreX * p.hDirX[idx] + srcToCentreY * p.hDirY[idx] + srcToCentreZ * p.hDirZ[idx]);
+
+		const bool closer = (denom != 0.0f) & (dist > 0.0f)
+			& ((p.halfWidth[idx] <= 0.0f) | (fabsf(u) <= p.halfWidth[idx]))
+			& ((p.halfHeight[idx] <= 0.0f) | (fabsf(v) <= p.halfHeight[idx]))
+			& (dist < nearestDist);
+		nearestDist = closer ? dist : nearestDist;
+		nearestIdx = closer ? (int)idx : nearestIdx;
+	}
+
+	if (nearestIdx >= 0)
+	{
+		hit.type = PrimitiveType::Plane;
+		hit.index = (unsigned)nearestIdx;
+		hit.distance = nearestDist;
+	}
+}
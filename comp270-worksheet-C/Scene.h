@@ -0,0 +1,111 @@
+#pragma once
+#include "Matrix3D.h"
+#include "Image.h"
+#include "AlignedArray.h"
+
+class Object;
+struct RayCounters;
+
+// A copy of the scene's objects grouped by type, with each type's properties stored in separate arrays
+// (structure-of-arrays), so that rays can be tested against every primitive of a type in a tight loop
+// without calling a virtual function per object.
+// The store is a snapshot: it must be rebuilt (with clear and addObjects) whenever the objects change.
+// The arrays are either owned by the store, or attached from elsewhere (e.g. a memory-mapped scene file) without copying.
+class Scene
+{
+public:
+	// The types of primitive held in the store
+	enum class PrimitiveType { None, Sphere, Plane };
+
+	// The closest primitive found along a ray
+	struct Hit
+	{
+		PrimitiveType	type = PrimitiveType::None;
+		unsigned		index = 0;				// Index of the primitive within the arrays for its type
+		float			distance = FLT_MAX;		// Distance along the ray to the intersection
+	};
+
+	// The arrays holding each property of the spheres
+	struct SphereArrays
+	{
+		unsigned		count = 0;
+		const float*	x = nullptr;			// Centre coordinates
+		const float*	y = nullptr;
+		const float*	z = nullptr;
+		const float*	radius2 = nullptr;		// Squared radii
+		const Colour*	colours = nullptr;
+	};
+
+	// The arrays holding each property of the planes (see Plane for the meaning of each property)
+	struct PlaneArrays
+	{
+		unsigned		count = 0;
+		const float*	x = nullptr;
+		const float*	y = nullptr;
+		const float*	z = nullptr;
+		const float*	normalX = nullptr;
+		const float*	normalY = nullptr;
+		const float*	normalZ = nullptr;
+		const float*	wDirX = nullptr;
+		const float*	wDirY = nullptr;
+		const float*	wDirZ = nullptr;
+		const float*	hDirX = nullptr;
+		const float*	hDirY = nullptr;
+		const float*	hDirZ = nullptr;
+		const float*	halfWidth = nullptr;
+		const float*	halfHeight = nullptr;
+		const Colour*	colours = nullptr;
+	};
+
+	Scene() {}
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	void	clear();
+	void	addObjects(const std::vector<Object*>& objects);
+	void	createObjects(std::vector<Object*>& objects) const;
+
+	void	addSphere(const Point3D& centre, float radius2, const Colour& colour);
+	void	addPlane(const Point3D& centre, const Vector3D& normal, const Vector3D& wDir, const Vector3D& hDir,
+					 float halfWidth, float halfHeight, const Colour& colour);
+
+	// Use arrays stored elsewhere instead of the store's own; they must stay valid until the store is cleared or destroyed.
+	// Adding primitives afterwards replaces the attached arrays with the store's own (empty) storage.
+	void	attach(const SphereArrays& spheres, const PlaneArrays& planes);
+
+	// Returns a number that changes whenever primitives are added or removed
+	unsigned	getRevision() const { return m_revision; }
+
+	unsigned	numSpheres() const { return m_spheres.count; }
+	unsigned	numPlanes() const { return m_planes.count; }
+
+	const SphereArrays&	getSpheres() const { return m_spheres; }
+	const PlaneArrays&	getPlanes() const { return m_planes; }
+
+	void			getClosestIntersection(const Point3D& raySrc, const Vector3D& rayDir, Hit& hit, RayCounters& counters) const;
+	const Colour&	getColour(const Hit& hit) const;
+
+private:
+	void	getClosestSphere(const Point3D& raySrc, const Vector3D& rayDir, Hit& hit) const;
+	void	getClosestPlane(const Point3D& raySrc, const Vector3D& rayDir, Hit& hit) const;
+	void	updateArrays();
+
+	// The arrays that are traced (pointing either at the storage below or at attached arrays)
+	SphereArrays	m_spheres;
+	PlaneArrays		m_planes;
+
+	// Storage for spheres added to the store
+	AlignedArray<float>	m_sphereX, m_sphereY, m_sphereZ;
+	AlignedArray<float>	m_sphereRadius2;
+	std::vector<Colour>	m_sphereColours;
+
+	// Storage for planes added to the store
+	AlignedArray<float>	m_planeX, m_planeY, m_planeZ;
+	AlignedArray<float>	m_planeNormalX, m_planeNormalY, m_planeNormalZ;
+	AlignedArray<float>	m_planeWDirX, m_planeWDirY, m_planeWDirZ;
+	AlignedArray<float>	m_planeHDirX, m_planeHDirY, m_planeHDirZ;
+	AlignedArray<float>	m_planeHalfWidth, m_planeHalfHeight;
+	std::vector<Colour>	m_planeColours;
+
+	unsigned	m_revision = 0;		// Incremented whenever the store changes
+};
\ No newline at end of file
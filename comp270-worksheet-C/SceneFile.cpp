@@ -0,0 +1,331 @@
+#include "stdafx.h"
+#include "SceneFile.h"
+
+namespace
+{
+	// Header at the start of a binary scene file
+	struct BinaryHeader
+	{
+		char		magic[8];			// c_binaryMagic, which includes the version of the format
+		uint32_t	numSpheres;
+		uint32_t	numPlanes;
+		float		cameraPosition[3];
+		float		viewPlane[3];		// Distance, half width and half height
+	};
+
+	const char		c_binaryMagic[8] = { 'C', '2', '7', '0', 'S', 'C', 'N', '1' };
+	const size_t	c_binaryAlignment = 64;
+
+	// The binary file holds these arrays in order, each with 4 bytes (a float or Colour) per primitive
+	const unsigned	c_numSphereArrays = 5;		// x, y, z, radius2, colours
+	const unsigned	c_numPlaneArrays = 15;		// x, y, z, normal, wDir, hDir, halfWidth, halfHeight, colours
+	const unsigned	c_numArrays = c_numSphereArrays + c_numPlaneArrays;
+
+	static_assert(sizeof(Colour) == 4 && sizeof(float) == 4, "Scene file arrays assume 4 bytes per element");
+
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + c_binaryAlignment - 1) / c_binaryAlignment * c_binaryAlignment;
+	}
+
+	// Works out where each array starts in a binary file, returning the total size of the file.
+	// The sizes are worked out in 64 bits whatever the platform, as the counts come from the file: in a 32-bit size_t,
+	// a crafted header could make the total wrap around to less than the size of the file.
+	uint64_t getBinaryLayout(uint32_t numSpheres, uint32_t numPlanes, uint64_t offsets[c_numArrays])
+	{
+		uint64_t offset = alignOffset(sizeof(BinaryHeader));
+		for (unsigned arrayIdx = 0; arrayIdx < c_numArrays; ++arrayIdx)
+		{
+			offsets[arrayIdx] = offset;
+			offset = alignOffset(offset + 4 * (uint64_t)(arrayIdx < c_numSphereArrays ? numSpheres : numPlanes));
+		}
+		return offset;
+	}
+
+	// Lists the arrays of a scene store in the order they are stored in a binary file
+	void getArrays(const Scene::SphereArrays& s, const Scene::PlaneArrays& p, const void* arrays[c_numArrays])
+	{
+		const void* ordered[c_numArrays] = {
+			s.x, s.y, s.z, s.radius2, s.colours,
+			p.x, p.y, p.z, p.normalX, p.normalY, p.normalZ, p.wDirX, p.wDirY, p.wDirZ,
+			p.hDirX, p.hDirY, p.hDirZ, p.halfWidth, p.halfHeight, p.colours };
+		memcpy(arrays, ordered, sizeof(ordered));
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Loads a scene from the given file, working out from its contents whether it is in the text or binary format.
+// Returns false (with a description from getError) if the file can't be read or isn't valid.
+bool SceneFile::load(const char* path)
+{
+	m_scene.clear();
+	m_camera = CameraSettings();
+	m_error.clear();
+
+	if (!m_file.open(path))
+	{
+		m_error = std::string("Couldn't open ") + path;
+		return false;
+	}
+
+	if (m_file.size() >= sizeof(c_binaryMagic) && memcmp(m_file.data(), c_binaryMagic, sizeof(c_binaryMagic)) == 0)
+		return attachBinary();
+
+	// The text has been copied into the store once it is parsed, so the file isn't needed any more
+	bool result = parseText(m_file.data(), m_file.size());
+	m_file.close();
+	return result;
+}
+
+// Fills the scene from a description in the text format.
+// Returns false (with a description from getError) if a line isn't valid.
+bool SceneFile::parseText(const char* text, size_t size)
+{
+	m_scene.clear();
+	m_camera = CameraSettings();
+	m_error.clear();
+
+	// Each line is copied so that it can be terminated and split up in place
+	char line[1024];
+	unsigned lineNumber = 1;
+	for (size_t pos = 0; pos < size; ++lineNumber)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(text + pos, '\n', size - pos));
+		const size_t length = (lineEnd != nullptr ? lineEnd - text : size) - pos;
+		if (length >= sizeof(line))
+		{
+			m_error = "Line " + std::to_string(lineNumber) + " is too long";
+			return false;
+		}
+
+		memcpy(line, text + pos, length);
+		line[length] = '\0';
+		pos += length + 1;
+
+		if (!parseLine(line))
+		{
+			m_error = "Line " + std::to_string(lineNumber) + ": " + m_error;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Writes a scene in the binary format, returning false if the file can't be written
+bool SceneFile::saveBinary(const char* path, const CameraSettings& camera, const Scene& scene)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	BinaryHeader header;
+	memcpy(header.magic, c_binaryMagic, sizeof(c_binaryMagic));
+	header.numSpheres = scene.numSpheres();
+	header.numPlanes = scene.numPlanes();
+	header.cameraPosition[0] = camera.position.x;
+	header.cameraPosition[1] = camera.position.y;
+	header.cameraPosition[2] = camera.position.z;
+	header.viewPlane[0] = camera.viewPlaneDistance;
+	header.viewPlane[1] = camera.viewPlaneHalfWidth;
+	header.viewPlane[2] = camera.viewPlaneHalfHeight;
+
+	uint64_t offsets[c_numArrays];
+	const uint64_t totalSize = getBinaryLayout(header.numSpheres, header.numPlanes, offsets);
+	const void* arrays[c_numArrays];
+	getArrays(scene.getSpheres(), scene.getPlanes(), arrays);
+
+	// Write each part, padding with zeros up to where the next one starts
+	const char padding[c_binaryAlignment] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t written = sizeof(header);
+	for (unsigned arrayIdx = 0; arrayIdx < c_numArrays; ++arrayIdx)
+	{
+		file.write(padding, (std::streamsize)(offsets[arrayIdx] - written));
+		const uint64_t arraySize = 4 * (uint64_t)(arrayIdx < c_numSphereArrays ? header.numSpheres : header.numPlanes);
+		if (arraySize > 0)
+			file.write(static_cast<const char*>(arrays[arrayIdx]), (std::streamsize)arraySize);
+		written = offsets[arrayIdx] + arraySize;
+	}
+	file.write(padding, (std::streamsize)(totalSize - written));
+
+	return file.good();
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Points the scene store at the arrays in the mapped binary file
+bool SceneFile::attachBinary()
+{
+	BinaryHeader header;
+	if (m_file.size() < sizeof(header))
+	{
+		m_error = "The binary scene header is incomplete";
+		return false;
+	}
+	memcpy(&header, m_file.data(), sizeof(header));
+
+	// Every offset is at most the total size, so once that is known to fit in the file they all fit in a size_t
+	uint64_t offsets[c_numArrays];
+	if ((uint64_t)m_file.size() < getBinaryLayout(header.numSpheres, header.numPlanes, offsets))
+	{
+		m_error = "The binary scene file is shorter than its header says";
+		return false;
+	}
+
+	m_camera.position = Point3D(header.cameraPosition[0], header.cameraPosition[1], header.cameraPosition[2]);
+	m_camera.viewPlaneDistance = header.viewPlane[0];
+	m_camera.viewPlaneHalfWidth = header.viewPlane[1];
+	m_camera.viewPlaneHalfHeight = header.viewPlane[2];
+
+	auto floats = [&](unsigned arrayIdx) { return reinterpret_cast<const float*>(m_file.data() + (size_t)offsets[arrayIdx]); };
+	auto colours = [&](unsigned arrayIdx) { return reinterpret_cast<const Colour*>(m_file.data() + (size_t)offsets[arrayIdx]); };
+
+	Scene::SphereArrays spheres;
+	spheres.count = header.numSpheres;
+	spheres.x = floats(0);
+	spheres.y = floats(1);
+	spheres.z = floats(2);
+	spheres.radius2 = floats(3);
+	spheres.colours = colours(4);
+
+	Scene::PlaneArrays planes;
+	planes.count = header.numPlanes;
+	planes.x = floats(5);
+	planes.y = floats(6);
+	planes.z = floats(7);
+	planes.normalX = floats(8);
+	planes.normalY = floats(9);
+	planes.normalZ = floats(10);
+	planes.wDirX = floats(11);
+	planes.wDirY = floats(12);
+	planes.wDirZ = floats(13);
+	planes.hDirX = floats(14);
+	planes.hDirY = floats(15);
+	planes.hDirZ = floats(16);
+	planes.halfWidth = floats(17);
+	planes.halfHeight = floats(18);
+	planes.colours = colours(19);
+
+	m_scene.attach(spheres, planes);
+	return true;
+}
+
+// Parses a single line of the text format, adding its item to the scene.
+// Returns false (setting m_error) if the line isn't valid.
+bool SceneFile::parseLine(char* line)
+{
+	// Ignore comments and blank lines
+	char* comment = strchr(line, '#');
+	if (comment != nullptr)
+		*comment = '\0';
+
+	char* cursor = line;
+	while (isspace((unsigned char)*cursor))
+		++cursor;
+	if (*cursor == '\0')
+		return true;
+
+	const char* keyword = cursor;
+	while (*cursor != '\0' && !isspace((unsigned char)*cursor))
+		++cursor;
+	if (*cursor != '\0')
+		*cursor++ = '\0';
+
+	// Read the numbers that follow the keyword
+	float values[16];
+	unsigned numValues = 0;
+	for (;;)
+	{
+		char* end;
+		const float value = strtof(cursor, &end);
+		if (end == cursor)
+			break;
+		if (numValues == 16)
+		{
+			m_error = "too many numbers";
+			return false;
+		}
+		if (!std::isfinite(value))
+		{
+			m_error = "numbers must be finite";
+			return false;
+		}
+		values[numValues++] = value;
+		cursor = end;
+	}
+	while (isspace((unsigned char)*cursor))
+		++cursor;
+	if (*cursor != '\0')
+	{
+		m_error = std::string("unexpected '") + cursor + "'";
+		return false;
+	}
+
+	// A sphere or plane's colour is its last three numbers. Converting a value outside 0-255 to a byte is undefined,
+	// so such colours are rejected (the comparisons are also false for NaN).
+	if ((strcmp(keyword, "sphere") == 0 && numValues == 7) || (strcmp(keyword, "plane") == 0 && numValues == 14))
+	{
+		for (unsigned valueIdx = numValues - 3; valueIdx < numValues; ++valueIdx)
+		{
+			if (!(values[valueIdx] >= 0.0f && values[valueIdx] <= 255.0f))
+			{
+				m_error = "colour components must be between 0 and 255";
+				return false;
+			}
+		}
+	}
+
+	auto getColour = [&](unsigned first) { return Colour((unsigned char)values[first], (unsigned char)values[first + 1], (unsigned char)values[first + 2]); };
+	const Colour defaultColour(126, 126, 126);
+
+	if (strcmp(keyword, "camera") == 0 && numValues == 3)
+	{
+		m_camera.position = Point3D(values[0], values[1], values[2]);
+	}
+	else if (strcmp(keyword, "viewplane") == 0 && numValues == 3)
+	{
+		if (values[0] <= 0.0f || values[1] <= 0.0f || values[2] <= 0.0f)
+		{
+			m_error = "the view plane distance and half extents must be positive";
+			return false;
+		}
+		m_camera.viewPlaneDistance = values[0];
+		m_camera.viewPlaneHalfWidth = values[1];
+		m_camera.viewPlaneHalfHeight = values[2];
+	}
+	else if (strcmp(keyword, "sphere") == 0 && (numValues == 4 || numValues == 7))
+	{
+		if (values[3] <= 0.0f)
+		{
+			m_error = "the sphere's radius must be positive";
+			return false;
+		}
+		m_scene.addSphere(Point3D(values[0], values[1], values[2]), values[3] * values[3],
+						  numValues == 7 ? getColour(4) : defaultColour);
+	}
+	else if (strcmp(keyword, "plane") == 0 && (numValues == 11 || numValues == 14))
+	{
+		// As in the Plane constructor, the width direction is perpendicular to the up direction and the normal
+		const Vector3D normal(values[3], values[4], values[5]);
+		const Vector3D up(values[6], values[7], values[8]);
+		const Vector3D widthDir = up.cross(normal);
+		if (!(widthDir.magnitude() > 0.0f))
+		{
+			// Either direction being zero, or the two being parallel, leaves the plane without a width direction
+			m_error = "the plane's normal and up direction must be non-zero and not parallel";
+			return false;
+		}
+		m_scene.addPlane(Point3D(values[0], values[1], values[2]), normal, widthDir, up,
+						 values[9] / 2.0f, values[10] / 2.0f, numValues == 14 ? getColour(11) : defaultColour);
+	}
+	else
+	{
+		m_error = std::string("expected camera (3 numbers), viewplane (3), sphere (4 or 7) or plane (11 or 14), but found '")
+			+ keyword + "' with " + std::to_string(numValues) + " numbers";
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Scene.h"
+#include "MappedFile.h"
+
+// Loads scene descriptions (camera settings plus spheres and planes) from files in either of two formats.
+//
+// Text format: one item per line, with numbers separated by spaces and '#' starting a comment:
+//	camera		x y z												Camera position
+//	viewplane	distance halfWidth halfHeight						View plane framing
+//	sphere		x y z radius [r g b]								Centre, radius and (optionally) colour
+//	plane		x y z nx ny nz upx upy upz width height [r g b]		As for the Plane constructor (zero width/height for infinite)
+// Every number must be finite. View plane distances and half extents, and sphere radii, must be positive, a plane's
+// normal and up direction must be non-zero and not parallel, and colour components (r g b) must be between 0 and 255.
+//
+// Binary format: a header followed by the scene store's arrays, each aligned to 64 bytes, so that a memory-mapped
+// file can be traced directly with no parsing or copying. Numbers are stored in the machine's (little-endian) order.
+class SceneFile
+{
+public:
+	// Camera settings stored with the scene
+	struct CameraSettings
+	{
+		Point3D	position = Point3D(0.0f, 0.0f, 20.0f);
+		float	viewPlaneDistance = 5.0f;
+		float	viewPlaneHalfWidth = 5.0f;
+		float	viewPlaneHalfHeight = 5.0f;
+	};
+
+	bool		load(const char* path);
+	bool		parseText(const char* text, size_t size);
+	static bool	saveBinary(const char* path, const CameraSettings& camera, const Scene& scene);
+
+	// The scene store refers to the loaded file, so it is only valid while this object exists
+	const Scene&			getScene() const { return m_scene; }
+	const CameraSettings&	getCamera() const { return m_camera; }
+
+	// Description of the last error from load/parseText
+	const std::string&		getError() const { return m_error; }
+
+private:
+	bool	attachBinary();
+	bool	parseLine(char* line);
+
+	MappedFile		m_file;		// Kept open for a binary file, whose arrays are used in place
+	Scene			m_scene;
+	CameraSettings	m_camera;
+	std::string		m_error;
+};
\ No newline at end of file
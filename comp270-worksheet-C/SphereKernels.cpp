@@ -0,0 +1,194 @@
+#include "stdafx.h"
+#include "SphereKernels.h"
+#include "CpuFeatures.h"
+#include <immintrin.h>
+
+// Fusing the multiplies and adds would change the rounding of the results, so stop GCC and Clang from doing so
+// (MSVC never contracts intrinsics).
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace SphereKernels
+{
+	// Plain C++ version, matching Sphere::getIntersection operation for operation
+	static void intersectScalar(const RayPacket& packet, const Point3D& centre, float radius2, const Object* sphere, PacketHits& hits)
+	{
+		const Vector3D srcToCentre = centre - packet.origin;
+		const float srcToCentreSq = srcToCentre.dot(srcToCentre);
+		for (unsigned idx = 0; idx < packet.count; ++idx)
+		{
+			const float tc = srcToCentre.x * packet.dirX[idx] + srcToCentre.y * packet.dirY[idx] + srcToCentre.z * packet.dirZ[idx];
+			if (tc > 0.0f)
+			{
+				const float distSq = srcToCentreSq - tc * tc;
+				if (distSq < radius2)
+				{
+					const float dist = tc - sqrtf(radius2 - distSq);
+					if (dist < hits.distance[idx])
+					{
+						hits.distance[idx] = dist;
+						hits.object[idx] = sphere;
+					}
+				}
+			}
+		}
+	}
+
+	// Records the sphere as the closest object for each ray whose bit is set in the mask
+	static void setHitObjects(unsigned mask, unsigned firstIdx, const Object* sphere, PacketHits& hits)
+	{
+		for (unsigned idx = firstIdx; mask != 0; ++idx, mask >>= 1)
+		{
+			if (mask & 1)
+				hits.object[idx] = sphere;
+		}
+	}
+
+	// 4 rays at a time
+	TARGET_SSE41 static void intersectSSE41(const RayPacket& packet, const Point3D& centre, float radius2, const Object* sphere, PacketHits& hits)
+	{
+		const Vector3D srcToCentre = centre - packet.origin;
+		const __m128 scX = _mm_set1_ps(srcToCentre.x), scY = _mm_set1_ps(srcToCentre.y), scZ = _mm_set1_ps(srcToCentre.z);
+		const __m128 scSq = _mm_set1_ps(srcToCentre.dot(srcToCentre));
+		const __m128 r2 = _mm_set1_ps(radius2);
+		const __m128 zero = _mm_setzero_ps();
+
+		for (unsigned idx = 0; idx < packet.count; idx += 4)
+		{
+			const __m128 tc = _mm_add_ps(_mm_add_ps(_mm_mul_ps(scX, _mm_load_ps(packet.dirX + idx)),
+													_mm_mul_ps(scY, _mm_load_ps(packet.dirY + idx))),
+										 _mm_mul_ps(scZ, _mm_load_ps(packet.dirZ + idx)));
+			const __m128 distSq = _mm_sub_ps(scSq, _mm_mul_ps(tc, tc));
+			const __m128 dist = _mm_sub_ps(tc, _mm_sqrt_ps(_mm_sub_ps(r2, distSq)));	// NaN for misses, which are masked out
+			const __m128 nearest = _mm_load_ps(hits.distance + idx);
+
+			const __m128 closer = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(tc, zero), _mm_cmplt_ps(distSq, r2)), _mm_cmplt_ps(dist, nearest));
+			_mm_store_ps(hits.distance + idx, _mm_blendv_ps(nearest, dist, closer));
+			setHitObjects((unsigned)_mm_movemask_ps(closer), idx, sphere, hits);
+		}
+	}
+
+	// 8 rays at a time
+	TARGET_AVX2 static void intersectAVX2(const RayPacket& packet, const Point3D& centre, float radius2, const Object* sphere, PacketHits& hits)
+	{
+		const Vector3D srcToCentre = centre - packet.origin;
+		const __m256 scX = _mm256_set1_ps(srcToCentre.x), scY = _mm256_set1_ps(srcToCentre.y), scZ = _mm256_set1_ps(srcToCentre.z);
+		const __m256 scSq = _mm256_set1_ps(srcToCentre.dot(srcToCentre));
+		const __m256 r2 = _mm256_set1_ps(radius2);
+		const __m256 zero = _mm256_setzero_ps();
+
+		for (unsigned idx = 0; idx < packet.count; idx += 8)
+		{
+			const __m256 tc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(scX, _mm256_load_ps(packet.dirX + idx)),
+														  _mm256_mul_ps(scY, _mm256_load_ps(packet.dirY + idx))),
+											_mm256_mul_ps(scZ, _mm256_load_ps(packet.dirZ + idx)));
+			const __m256 distSq = _mm256_sub_ps(scSq, _mm256_mul_ps(tc, tc));
+			const __m256 dist = _mm256_sub_ps(tc, _mm256_sqrt_ps(_mm256_sub_ps(r2, distSq)));
+			const __m256 nearest = _mm256_load_ps(hits.distance + idx);
+
+			const __m256 closer = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(tc, zero, _CMP_GT_OQ), _mm256_cmp_ps(distSq, r2, _CMP_LT_OQ)),
+												_mm256_cmp_ps(dist, nearest, _CMP_LT_OQ));
+			_mm256_store_ps(hits.distance + idx, _mm256_blendv_ps(nearest, dist, closer));
+			setHitObjects((unsigned)_mm256_movemask_ps(closer), idx, sphere, hits);
+		}
+	}
+
+	// 16 rays at a time (a whole packet)
+	TARGET_AVX512 static void intersectAVX512(const RayPacket& packet, const Point3D& centre, float radius2, const Object* sphere, PacketHits& hits)
+	{
+		const Vector3D srcToCentre = centre - packet.origin;
+		const __m512 scX = _mm512_set1_ps(srcToCentre.x), scY = _mm512_set1_ps(srcToCentre.y), scZ = _mm512_set1_ps(srcToCentre.z);
+		const __m512 scSq = _mm512_set1_ps(srcToCentre.dot(srcToCentre));
+		const __m512 r2 = _mm512_set1_ps(radius2);
+		const __m512 zero = _mm512_setzero_ps();
+
+		const __m512 tc = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(scX, _mm512_load_ps(packet.dirX)),
+													  _mm512_mul_ps(scY, _mm512_load_ps(packet.dirY))),
+										_mm512_mul_ps(scZ, _mm512_load_ps(packet.dirZ)));
+		const __m512 distSq = _mm512_sub_ps(scSq, _mm512_mul_ps(tc, tc));
+		const __mmask16 inside = _mm512_cmp_ps_mask(tc, zero, _CMP_GT_OQ) & _mm512_cmp_ps_mask(distSq, r2, _CMP_LT_OQ);
+		const __m512 dist = _mm512_sub_ps(tc, _mm512_mask_sqrt_ps(zero, inside, _mm512_sub_ps(r2, distSq)));
+		const __m512 nearest = _mm512_load_ps(hits.distance);
+
+		const __mmask16 closer = inside & _mm512_cmp_ps_mask(dist, nearest, _CMP_LT_OQ);
+		_mm512_store_ps(hits.distance, _mm512_mask_blend_ps(closer, nearest, dist));
+		setHitObjects((unsigned)closer, 0, sphere, hits);
+	}
+
+	// Returns the widest kernel the CPU supports
+	static Type getBestType()
+	{
+		const Type types[] = { Type::AVX512, Type::AVX2, Type::SSE41 };
+		for (Type type : types)
+		{
+			if (isSupported(type))
+				return type;
+		}
+		return Type::Scalar;
+	}
+
+	static Type			s_activeType = getBestType();
+	static PacketKernel	s_activeKernel = getKernel(s_activeType);
+
+	//----------------------------------------------------------------------------------------------------------------//
+
+	PacketKernel getKernel(Type type)
+	{
+		switch (type)
+		{
+		case Type::SSE41:	return intersectSSE41;
+		case Type::AVX2:	return intersectAVX2;
+		case Type::AVX512:	return intersectAVX512;
+		default:			return intersectScalar;
+		}
+	}
+
+	// Returns true if the CPU can run the given kernel
+	bool isSupported(Type type)
+	{
+		const CpuFeatures& features = CpuFeatures::get();
+		switch (type)
+		{
+		case Type::SSE41:	return features.sse41;
+		case Type::AVX2:	return features.avx2;
+		case Type::AVX512:	return features.avx512f;
+		default:			return true;
+		}
+	}
+
+	const char* getName(Type type)
+	{
+		switch (type)
+		{
+		case Type::SSE41:	return "sse4.1";
+		case Type::AVX2:	return "avx2";
+		case Type::AVX512:	return "avx512";
+		default:			return "scalar";
+		}
+	}
+
+	PacketKernel getActiveKernel()
+	{
+		return s_activeKernel;
+	}
+
+	Type getActiveType()
+	{
+		return s_activeType;
+	}
+
+	// Returns false (leaving the kernel unchanged) if the CPU can't run the given kernel.
+	// This should not be called while a frame is being rendered.
+	bool setActiveType(Type type)
+	{
+		if (!isSupported(type))
+			return false;
+
+		s_activeType = type;
+		s_activeKernel = getKernel(type);
+		return true;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "RayPacket.h"
+
+// Kernels that intersect every ray in a packet with a single sphere, keeping the closest hit for each ray.
+// The SIMD versions process 4, 8 or 16 rays at a time, and all versions give bit-identical results to
+// Sphere::getIntersection (no fused multiply-adds are used, and SIMD square roots are correctly rounded).
+namespace SphereKernels
+{
+	enum class Type { Scalar, SSE41, AVX2, AVX512 };
+
+	// Params:
+	//	packet		the rays to test (input)
+	//	centre		centre of the sphere (input)
+	//	radius2		squared radius of the sphere (input)
+	//	sphere		the object to record for rays that hit the sphere (input)
+	//	hits		closest hit for each ray so far, updated where the sphere is closer (input/output)
+	typedef void (*PacketKernel)(const RayPacket& packet, const Point3D& centre, float radius2, const Object* sphere, PacketHits& hits);
+
+	PacketKernel	getKernel(Type type);
+	bool			isSupported(Type type);
+	const char*		getName(Type type);
+
+	// Get/set the kernel used by Sphere (by default, the widest one the CPU supports)
+	PacketKernel	getActiveKernel();
+	Type			getActiveType();
+	bool			setActiveType(Type type);
+}
@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+ThreadPool::~ThreadPool()
+{
+	stopWorkers();
+}
+
+// Restarts the pool with the given number of worker threads
+void ThreadPool::setWorkerCount(unsigned count)
+{
+	if (count == workerCount() && !m_queues.empty())
+		return;
+
+	stopWorkers();
+	startWorkers(count);
+}
+
+// Queues the tasks across all threads' queues, wakes the workers and helps out until the batch is finished
+void ThreadPool::parallelFor(unsigned count, const std::function<void(unsigned)>& task)
+{
+	if (count == 0)
+		return;
+
+	if (m_workers.empty())
+	{
+		for (unsigned index = 0; index < count; ++index)
+			task(index);
+		return;
+	}
+
+	m_task = &task;
+	m_remaining = count;
+
+	// Give each thread a contiguous run of indices, so neighbouring tasks tend to stay on the same thread
+	const unsigned numQueues = (unsigned)m_queues.size();
+	for (unsigned queueIdx = 0; queueIdx < numQueues; ++queueIdx)
+	{
+		std::lock_guard<std::mutex> lock(m_queues[queueIdx]->mutex);
+		for (unsigned index = count * queueIdx / numQueues; index < count * (queueIdx + 1) / numQueues; ++index)
+			m_queues[queueIdx]->indices.push_back(index);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_batch;
+	}
+	m_wakeWorkers.notify_all();
+
+	runTasks(numQueues - 1);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_batchDone.wait(lock, [this] { return m_remaining == 0; });
+	m_task = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------------------------//
+
+// Creates the queues and spawns the worker threads
+void ThreadPool::startWorkers(unsigned count)
+{
+	m_shutdown = false;
+	for (unsigned queueIdx = 0; queueIdx <= count; ++queueIdx)
+		m_queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+
+	for (unsigned queueIdx = 0; queueIdx < count; ++queueIdx)
+		m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, queueIdx));
+}
+
+// Signals the worker threads to finish and waits for them to exit
+void ThreadPool::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_wakeWorkers.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+	m_queues.clear();
+}
+
+// Main loop for a worker thread: sleep until a batch is queued, then run tasks until there are none left to steal
+void ThreadPool::workerLoop(unsigned queueIdx)
+{
+	PROFILE_THREAD_NAME("Worker");
+
+	unsigned lastBatch = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		lastBatch = m_batch;
+	}
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeWorkers.wait(lock, [&] { return m_shutdown || m_batch != lastBatch; });
+			if (m_shutdown)
+				return;
+			lastBatch = m_batch;
+		}
+
+		runTasks(queueIdx);
+	}
+}
+
+// Runs tasks from the given queue, then from the other threads' queues, until all are empty
+void ThreadPool::runTasks(unsigned queueIdx)
+{
+	unsigned index;
+	while (popTask(queueIdx, index) || stealTask(queueIdx, index))
+	{
+		(*m_task)(index);
+
+		if (--m_remaining == 0)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_batchDone.notify_all();
+		}
+	}
+}
+
+// Takes the most recently queued task from the given queue
+bool ThreadPool::popTask(unsigned queueIdx, unsigned& index)
+{
+	TaskQueue& queue = *m_queues[queueIdx];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.indices.empty())
+		return false;
+
+	index = queue.indices.back();
+	queue.indices.pop_back();
+	return true;
+}
+
+// Takes the oldest task from another thread's queue, starting with the thread's neighbour
+bool ThreadPool::stealTask(unsigned thiefIdx, unsigned& index)
+{
+	const unsigned numQueues = (unsigned)m_queues.size();
+	for (unsigned offset = 1; offset < numQueues; ++offset)
+	{
+		TaskQueue& queue = *m_queues[(thiefIdx + offset) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.indices.empty())
+		{
+			index = queue.indices.front();
+			queue.indices.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// A persistent pool of worker threads for running batches of independent tasks.
+// Each thread owns a queue of task indices; threads that run out of work steal from the front of the others' queues.
+class ThreadPool
+{
+public:
+	ThreadPool() {}
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Set the number of worker threads (in addition to the calling thread); zero runs every task on the caller
+	void		setWorkerCount(unsigned count);
+	unsigned	workerCount() const { return (unsigned)m_workers.size(); }
+
+	// Calls task(index) for each index in [0, count), spread over the workers and the calling thread.
+	// Returns once every task has completed.
+	void		parallelFor(unsigned count, const std::function<void(unsigned)>& task);
+
+private:
+	// Task indices waiting to be run by a thread (the back is popped by the owner, the front is stolen by others)
+	struct TaskQueue
+	{
+		std::mutex				mutex;
+		std::deque<unsigned>	indices;
+	};
+
+	void	startWorkers(unsigned count);
+	void	stopWorkers();
+	void	workerLoop(unsigned queueIdx);
+	void	runTasks(unsigned queueIdx);
+	bool	popTask(unsigned queueIdx, unsigned& index);
+	bool	stealTask(unsigned thiefIdx, unsigned& index);
+
+	std::vector<std::thread>				m_workers;
+	std::vector<std::unique_ptr<TaskQueue>>	m_queues;		// One per worker, plus a final one for the calling thread
+
+	const std::function<void(unsigned)>*	m_task = nullptr;	// The task for the current batch
+	std::atomic<unsigned>					m_remaining{ 0 };	// Number of tasks in the current batch not yet completed
+
+	std::mutex					m_mutex;			// Guards m_batch, m_shutdown and the condition variables
+	std::condition_variable		m_wakeWorkers;		// Signalled when a new batch is queued or the pool shuts down
+	std::condition_variable		m_batchDone;		// Signalled when the last task of a batch completes
+	unsigned					m_batch = 0;		// Incremented each time a new batch is queued
+	bool						m_shutdown = false;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+// Hands values from one producer thread to one consumer thread without locking, always giving the consumer the most
+// recently published value (values published in between its reads are skipped, so it never falls behind).
+// Three copies are kept: the one being written, the one being read, and the latest published one between them.
+// Publishing swaps the written copy with the middle one, and reading swaps the middle one with the read copy,
+// each with a single atomic exchange, so neither thread ever waits for the other.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() {}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Producer: returns the copy to fill in before calling publish (it may hold an old value, so every field should be set)
+	T&	getWriteBuffer() { return m_buffers[m_writeIdx]; }
+
+	// Producer: makes the write buffer the latest value, and takes over the copy it replaces for writing the next one
+	void publish()
+	{
+		m_writeIdx = m_middle.exchange(m_writeIdx | c_newFlag, std::memory_order_acq_rel) & c_indexMask;
+	}
+
+	// Consumer: returns true if a value has been published since the last call to update
+	bool hasNew() const { return (m_middle.load(std::memory_order_acquire) & c_newFlag) != 0; }
+
+	// Consumer: switches the read buffer to the latest published value, if there is a new one.
+	// Returns true if it changed.
+	bool update()
+	{
+		if (!hasNew())
+			return false;
+
+		m_readIdx = m_middle.exchange(m_readIdx, std::memory_order_acq_rel) & c_indexMask;
+		return true;
+	}
+
+	// Consumer: returns the value received by the last call to update (or a default value if nothing has been received)
+	const T&	getReadBuffer() const { return m_buffers[m_readIdx]; }
+
+private:
+	// m_middle holds the index of the middle copy, plus c_newFlag if it hasn't been read yet
+	static const unsigned	c_indexMask = 3;
+	static const unsigned	c_newFlag = 4;
+
+	T						m_buffers[3];
+	unsigned				m_writeIdx = 0;		// Only used by the producer
+	std::atomic<unsigned>	m_middle{ 1 };
+	unsigned				m_readIdx = 2;		// Only used by the consumer
+};
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
+#include "VectorMath.h"
 
 // A class for performing basic operations with homogeneous vectors in 3D space.
+// The components are stored together, so the operations below work on all of them at once with SSE (see VectorMath.h).
+// The class isn't over-aligned: the loads/stores are unaligned, so vectors can live in heap-allocated objects.
 // Feel free to edit/extend!
 class Vector3D
 {
@@ -12,37 +15,34 @@ public:
 	// Get the length of the vector
 	float magnitude() const
 	{
-		return sqrt(x * x + y * y + z * z);
+		return sqrt(dot(*this));
 	}
 
 	// Make the vector unit length
 	void normalise()
 	{
-		float mag = magnitude();
-		x /= mag;
-		y /= mag;
-		z /= mag;
+		VectorMath::store(&x, VectorMath::normalise3(VectorMath::load(&x)));
 	}
 
 	// Vector dot product
 	float dot(const Vector3D& other) const
 	{
-		return x * other.x + y * other.y + z * other.z;
+		return _mm_cvtss_f32(VectorMath::dot3(VectorMath::load(&x), VectorMath::load(&other.x)));
 	}
 
 	// Vector cross product
 	Vector3D cross(const Vector3D& other) const
 	{
 		Vector3D result;
-		result.x = y * other.z - z * other.y;
-		result.y = z * other.x - x * other.z;
-		result.z = x * other.y - y * other.x;
+		VectorMath::store(&result.x, VectorMath::cross3(VectorMath::load(&x), VectorMath::load(&other.x)));
 		return result;
 	}
 
-	// Multiply the vector by as scalar
+	// Multiply the vector by as scalar (leaving w unchanged)
 	Vector3D operator*(float scalar) const
 	{
-		return Vector3D(x * scalar, y * scalar, z * scalar);
+		Vector3D result;
+		VectorMath::store(&result.x, _mm_mul_ps(VectorMath::load(&x), _mm_set_ps(1.0f, scalar, scalar, scalar)));
+		return result;
 	}
 };
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "stdafx.h"
+#include "VectorMath.h"
+
+// Params:
+//	x, y, z		components of the vectors (input/output)
+//	count		number of vectors
+void VectorMath::normaliseArrays(float* x, float* y, float* z, unsigned count)
+{
+	unsigned idx = 0;
+	for (; idx + 4 <= count; idx += 4)
+	{
+		const __m128 vx = _mm_loadu_ps(x + idx), vy = _mm_loadu_ps(y + idx), vz = _mm_loadu_ps(z + idx);
+		const __m128 invLength = rsqrt(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+		_mm_storeu_ps(x + idx, _mm_mul_ps(vx, invLength));
+		_mm_storeu_ps(y + idx, _mm_mul_ps(vy, invLength));
+		_mm_storeu_ps(z + idx, _mm_mul_ps(vz, invLength));
+	}
+
+	// Finish the last few one at a time, with the same calculation
+	for (; idx < count; ++idx)
+	{
+		const __m128 vx = _mm_set_ss(x[idx]), vy = _mm_set_ss(y[idx]), vz = _mm_set_ss(z[idx]);
+		const __m128 invLength = rsqrt(_mm_add_ss(_mm_add_ss(_mm_mul_ss(vx, vx), _mm_mul_ss(vy, vy)), _mm_mul_ss(vz, vz)));
+		x[idx] = _mm_cvtss_f32(_mm_mul_ss(vx, invLength));
+		y[idx] = _mm_cvtss_f32(_mm_mul_ss(vy, invLength));
+		z[idx] = _mm_cvtss_f32(_mm_mul_ss(vz, invLength));
+	}
+}
\ No newline at end of file
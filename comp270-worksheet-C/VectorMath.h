@@ -0,0 +1,49 @@
+#pragma once
+#include <emmintrin.h>
+
+// SSE helpers underneath Vector3D and Point3D, which keep their x, y, z and w components together so that they load
+// straight into one register. Only SSE2 is used, which every x64 CPU has (and 32-bit builds enable by default),
+// so no CPU feature checks are needed.
+// Sums are added in x, y, z order, so dot and cross products match the plain C++ expressions bit for bit;
+// normalising uses an approximate reciprocal square root, so it can differ from dividing by the length in the last bit or two.
+namespace VectorMath
+{
+	// Loads and stores are unaligned, as 32-bit heap allocations are only 8-byte aligned
+	inline __m128	load(const float* xyzw) { return _mm_loadu_ps(xyzw); }
+	inline void		store(float* xyzw, __m128 v) { _mm_storeu_ps(xyzw, v); }
+
+	// Returns a.x * b.x + a.y * b.y + a.z * b.z in the lowest component
+	inline __m128 dot3(__m128 a, __m128 b)
+	{
+		const __m128 product = _mm_mul_ps(a, b);
+		const __m128 sum = _mm_add_ss(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(1, 1, 1, 1)));
+		return _mm_add_ss(sum, _mm_movehl_ps(product, product));
+	}
+
+	// Returns the cross product of the first three components (the fourth component is a.w * b.w - a.w * b.w, i.e. zero)
+	inline __m128 cross3(__m128 a, __m128 b)
+	{
+		const __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 crossZXY = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+		return _mm_shuffle_ps(crossZXY, crossZXY, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	// Returns 1 / sqrt(x) for each component: the hardware's 12-bit estimate, refined by a Newton-Raphson step to about 22 bits
+	inline __m128 rsqrt(__m128 x)
+	{
+		const __m128 estimate = _mm_rsqrt_ps(x);
+		const __m128 halfXEstimate = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), x), estimate);
+		return _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(halfXEstimate, estimate)));
+	}
+
+	// Scales the first three components to unit length (a zero w stays zero)
+	inline __m128 normalise3(__m128 v)
+	{
+		const __m128 lengthSq = dot3(v, v);
+		return _mm_mul_ps(v, rsqrt(_mm_shuffle_ps(lengthSq, lengthSq, _MM_SHUFFLE(0, 0, 0, 0))));
+	}
+
+	// Normalises count vectors stored as separate x, y and z arrays, four at a time
+	void	normaliseArrays(float* x, float* y, float* z, unsigned count);
+}
\ No newline at end of file
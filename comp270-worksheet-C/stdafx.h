@@ -21,4 +21,16 @@
 // reference additional headers your program requires here
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <cstdint>
 #include <SDL.h>
\ No newline at end of file